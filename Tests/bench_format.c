@@ -0,0 +1,126 @@
+/* Compares IsaFormat against the C library's snprintf on the conversions the
+ * logger sees most. %r has no printf equivalent, so it is compared against
+ * %.17g, the shortest printf format that always round-trips.
+ *
+ * Build: cc -O2 -pthread bench_format.c -o bench_format
+ * Usage: bench_format [iterations]
+ */
+
+#include "../isa.h"
+
+typedef enum bench_case
+{
+    Case_Int,
+    Case_U64,
+    Case_Hex,
+    Case_String,
+    Case_Fixed,
+    Case_Shortest,
+    Case_Line,
+    Case_Count,
+} bench_case;
+
+const char *CaseNames[Case_Count] = {
+    "%d", "%llu", "%08x", "%s", "%.3f", "%r/%.17g", "log line",
+};
+
+f64
+NowSeconds(void)
+{
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (f64)Now.tv_sec + ((f64)Now.tv_nsec / 1e9);
+}
+
+/* Values change every iteration so neither side can be constant-folded */
+u64
+Run(bench_case Case, bool UseIsa, u64 Iterations)
+{
+    char Buffer[256] = { 0 };
+    u64  Sink        = 0;
+    for(u64 i = 0; i < Iterations; ++i)
+    {
+        i64 Len   = 0;
+        f64 Value = (f64)(i * 7919) / 1024.0;
+        switch(Case)
+        {
+            case Case_Int:
+            {
+                int Int = (int)(i * 2654435761U);
+                Len     = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%d", Int)
+                                 : snprintf(Buffer, sizeof(Buffer), "%d", Int);
+            }
+            break;
+            case Case_U64:
+            {
+                unsigned long long U64 = i * 0x9E3779B97F4A7C15ULL;
+                Len                    = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%llu", U64)
+                                                : snprintf(Buffer, sizeof(Buffer), "%llu", U64);
+            }
+            break;
+            case Case_Hex:
+            {
+                unsigned Hex = (unsigned)(i * 2654435761U);
+                Len          = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%08x", Hex)
+                                      : snprintf(Buffer, sizeof(Buffer), "%08x", Hex);
+            }
+            break;
+            case Case_String:
+            {
+                const char *String = (i & 1) ? "connection reset by peer" : "ok";
+                Len                = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%s", String)
+                                            : snprintf(Buffer, sizeof(Buffer), "%s", String);
+            }
+            break;
+            case Case_Fixed:
+            {
+                Len = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%.3f", Value)
+                             : snprintf(Buffer, sizeof(Buffer), "%.3f", Value);
+            }
+            break;
+            case Case_Shortest:
+            {
+                Len = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "%r", Value)
+                             : snprintf(Buffer, sizeof(Buffer), "%.17g", Value);
+            }
+            break;
+            case Case_Line:
+            {
+                Len = UseIsa ? IsaFormat(Buffer, sizeof(Buffer), "request %llu from %s took %d us (%.2f%% cpu)",
+                                         (unsigned long long)i, "10.0.0.1", (int)(i % 1000), Value)
+                             : snprintf(Buffer, sizeof(Buffer), "request %llu from %s took %d us (%.2f%% cpu)",
+                                        (unsigned long long)i, "10.0.0.1", (int)(i % 1000), Value);
+            }
+            break;
+            default:
+                break;
+        }
+        Sink += (u64)Len + (u8)Buffer[0];
+    }
+
+    return Sink;
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64 Iterations = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 2000000;
+
+    printf("%-10s %14s %14s %8s\n", "format", "snprintf ns", "IsaFormat ns", "speedup");
+
+    u64 Sink = 0;
+    for(u32 Case = 0; Case < Case_Count; ++Case)
+    {
+        f64 Start = NowSeconds();
+        Sink += Run((bench_case)Case, false, Iterations);
+        f64 Libc = (NowSeconds() - Start) * 1e9 / (f64)Iterations;
+
+        Start = NowSeconds();
+        Sink += Run((bench_case)Case, true, Iterations);
+        f64 Isa = (NowSeconds() - Start) * 1e9 / (f64)Iterations;
+
+        printf("%-10s %14.1f %14.1f %7.2fx\n", CaseNames[Case], Libc, Isa, Libc / Isa);
+    }
+
+    return (0 == Sink) ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/* Measures what logging costs: lines per second and per-call latency
+ * percentiles for each backend, on one thread and on several at once, with
+ * short and long messages, writing to /dev/null, a file and a pipe.
+ *
+ * Every run prints one CSV row to stdout, so results can be kept and diffed to
+ * catch regressions. The logger's own output is redirected to the target, so
+ * only the rows reach the terminal. Lines/s counts the lines that reached the
+ * target, so lines the async backend dropped are left out. It includes the
+ * time it takes to flush whatever the backend buffered, and for the async
+ * backend, the time until the flusher has written every line. Latency is per
+ * call, as seen by the thread that logs. Long messages do not fit in ISA_LOG_BUF_SIZE, so they also
+ * measure the spill path.
+ *
+ * Build: cc -O2 -pthread bench_log.c -o bench_log
+ * Usage: bench_log [lines per thread] [threads] [file to log to]
+ */
+
+#define ISA_LOG_ASYNC
+#define ISA_LOG_BINARY
+#define ISA_LOG_LEVEL ISA_LOG_LEVEL_INF /* Keeps -DNDEBUG builds from compiling the calls away */
+#include "../isa.h"
+
+ISA_LOG_REGISTER(Bench);
+
+typedef enum bench_backend
+{
+    Backend_Sync,
+    Backend_NoModule,
+    Backend_Fields,
+    Backend_Async,
+    Backend_Binary,
+    Backend_FileSink,
+    Backend_RingSink,
+    Backend_Count,
+} bench_backend;
+
+const char *BackendNames[Backend_Count] = {
+    "sync", "nomodule", "fields", "async", "binary", "filesink", "ringsink",
+};
+
+typedef enum bench_target
+{
+    Target_Null,
+    Target_File,
+    Target_Pipe,
+    Target_Count,
+} bench_target;
+
+const char *TargetNames[Target_Count] = {
+    "null",
+    "file",
+    "pipe",
+};
+
+typedef struct bench_job
+{
+    bench_backend Backend;
+    bool          Long;
+    u64           Lines;
+    u32          *Latencies; /* Nanoseconds, one per line */
+} bench_job;
+
+typedef struct bench_result
+{
+    f64 Seconds;
+    u64 Dropped;
+    u32 P50;
+    u32 P99;
+    u32 P999;
+    u32 Max;
+} bench_result;
+
+char LongPayload[512];
+
+u64
+NowNs(void)
+{
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return ((u64)Now.tv_sec * 1000000000ULL) + (u64)Now.tv_nsec;
+}
+
+void
+RunJob(void *Arg)
+{
+    bench_job *Job = (bench_job *)Arg;
+    for(u64 i = 0; i < Job->Lines; ++i)
+    {
+        unsigned long long Id    = (unsigned long long)i;
+        u64                Start = NowNs();
+        switch(Job->Backend)
+        {
+            case Backend_NoModule:
+            {
+                if(Job->Long)
+                {
+                    IsaLogInfoNoModule("request %llu failed: %s", Id, LongPayload);
+                }
+                else
+                {
+                    IsaLogInfoNoModule("request %llu took %d us", Id, 42);
+                }
+            }
+            break;
+            case Backend_Fields:
+            {
+                if(Job->Long)
+                {
+                    IsaLogInfoFields("request failed", IsaLogFieldUint("id", Id), IsaLogFieldStr("error", LongPayload));
+                }
+                else
+                {
+                    IsaLogInfoFields("request done", IsaLogFieldUint("id", Id), IsaLogFieldInt("us", 42));
+                }
+            }
+            break;
+            default:
+            {
+                if(Job->Long)
+                {
+                    IsaLogInfo("request %llu failed: %s", Id, LongPayload);
+                }
+                else
+                {
+                    IsaLogInfo("request %llu took %d us", Id, 42);
+                }
+            }
+            break;
+        }
+        Job->Latencies[i] = (u32)IsaMin(NowNs() - Start, (u64)UINT32_MAX);
+    }
+}
+
+int
+CompareU32(const void *A, const void *B)
+{
+    u32 ValueA = *(const u32 *)A;
+    u32 ValueB = *(const u32 *)B;
+    return (ValueA > ValueB) - (ValueA < ValueB);
+}
+
+/**
+ * @brief Points the logger at the target for one run
+ * @return false if the backend can not write to this target
+ */
+bool
+BeginBackend(bench_backend Backend, const char *Path, isa_log_sink **Sink)
+{
+    switch(Backend)
+    {
+        case Backend_Async:
+        {
+            return IsaLogAsyncStart();
+        }
+        break;
+        case Backend_Binary:
+        {
+            return IsaLogBinaryOpen(Path, NULL);
+        }
+        break;
+        case Backend_FileSink:
+        {
+            *Sink = IsaLogFileSinkCreate(Path, 0, 0, 0);
+        }
+        break;
+        case Backend_RingSink:
+        {
+            // NOTE(ingar): The ring maps its file, which /dev/null and pipes
+            // do not allow
+            *Sink = IsaLogRingFileSinkCreate(Path, IsaMebiByte(64));
+        }
+        break;
+        default:
+        {
+            return true;
+        }
+        break;
+    }
+
+    return *Sink && IsaLogAddSink(*Sink);
+}
+
+void
+EndBackend(bench_backend Backend, isa_log_sink *Sink)
+{
+    switch(Backend)
+    {
+        case Backend_Async:
+        {
+            IsaLogAsyncFlush();
+            IsaLogAsyncShutdown();
+        }
+        break;
+        case Backend_Binary:
+        {
+            IsaLogBinaryClose();
+        }
+        break;
+        case Backend_FileSink:
+        case Backend_RingSink:
+        {
+            IsaLogFlushSinks();
+            IsaLogRemoveSink(Sink);
+            IsaLogSinkClose(Sink);
+        }
+        break;
+        default:
+        {
+        }
+        break;
+    }
+}
+
+bool
+Measure(bench_backend Backend, const char *Path, bool Long, u64 Lines, u32 ThreadCount, u32 *Latencies,
+        bench_result *Result)
+{
+    isa_thread Threads[64];
+    bench_job  Jobs[64];
+
+    isa_log_sink *Sink    = NULL;
+    u64           Dropped = IsaLogAsyncDroppedCount();
+    if(!BeginBackend(Backend, Path, &Sink))
+    {
+        if(Sink)
+        {
+            IsaLogSinkClose(Sink);
+        }
+        return false;
+    }
+
+    u64 Start = NowNs();
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].Backend   = Backend;
+        Jobs[i].Long      = Long;
+        Jobs[i].Lines     = Lines;
+        Jobs[i].Latencies = Latencies + (i * Lines);
+        IsaThreadCreate(&Threads[i], RunJob, &Jobs[i]);
+    }
+
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        IsaThreadJoin(&Threads[i]);
+    }
+    EndBackend(Backend, Sink);
+
+    u64 Count       = Lines * ThreadCount;
+    Result->Seconds = (f64)(NowNs() - Start) / 1e9;
+    Result->Dropped = IsaLogAsyncDroppedCount() - Dropped;
+
+    qsort(Latencies, Count, sizeof(u32), CompareU32);
+    Result->P50  = Latencies[(Count * 50) / 100];
+    Result->P99  = Latencies[(Count * 99) / 100];
+    Result->P999 = Latencies[(Count * 999) / 1000];
+    Result->Max  = Latencies[Count - 1];
+
+    return true;
+}
+
+void
+DrainPipe(void *Arg)
+{
+    int  Fd = *(int *)Arg;
+    char Buffer[IsaKibiByte(64)];
+    while(read(Fd, Buffer, sizeof(Buffer)) > 0)
+    {
+    }
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64         Lines       = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 200000;
+    u32         ThreadCount = (ArgCount > 2) ? (u32)strtoul(Args[2], NULL, 10) : 4;
+    const char *FilePath    = (ArgCount > 3) ? Args[3] : "bench_log.out";
+    Lines                   = IsaMax(Lines, (u64)1);
+    ThreadCount             = IsaMin(IsaMax(ThreadCount, 1u), 64u);
+
+    memset(LongPayload, 'x', sizeof(LongPayload) - 1);
+
+    u32 *Latencies = (u32 *)malloc(Lines * ThreadCount * sizeof(u32));
+    if(!Latencies)
+    {
+        fprintf(stderr, "Could not allocate memory for latencies!\n");
+        return 1;
+    }
+
+    // NOTE(ingar): The logger writes to stdout, so the results get a copy of
+    // it and stdout is pointed at each target in turn
+    fflush(stdout);
+    int   StdoutFd = dup(STDOUT_FILENO);
+    FILE *Results  = fdopen(StdoutFd, "w");
+    if(!Results)
+    {
+        fprintf(stderr, "Could not duplicate stdout!\n");
+        return 1;
+    }
+
+    fprintf(Results, "backend,target,threads,message,lines,seconds,lines_per_sec,p50_ns,p99_ns,p999_ns,max_ns,"
+                     "dropped\n");
+    fflush(Results);
+
+    for(u32 Target = 0; Target < Target_Count; ++Target)
+    {
+        int        TargetFd   = -1;
+        int        PipeFds[2] = { -1, -1 };
+        isa_thread Drainer;
+        char       Path[64];
+        switch(Target)
+        {
+            case Target_Null:
+            {
+                TargetFd = open("/dev/null", O_WRONLY);
+                snprintf(Path, sizeof(Path), "/dev/null");
+            }
+            break;
+            case Target_File:
+            {
+                TargetFd = open(FilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                snprintf(Path, sizeof(Path), "%s", FilePath);
+            }
+            break;
+            case Target_Pipe:
+            {
+                if(0 == pipe(PipeFds))
+                {
+                    TargetFd = PipeFds[1];
+                    IsaThreadCreate(&Drainer, DrainPipe, &PipeFds[0]);
+                    snprintf(Path, sizeof(Path), "/dev/fd/%d", PipeFds[1]);
+                }
+            }
+            break;
+        }
+
+        if(TargetFd < 0)
+        {
+            fprintf(stderr, "Could not open the %s target!\n", TargetNames[Target]);
+            continue;
+        }
+
+        u32 ThreadCounts[] = { 1, ThreadCount };
+        for(u32 Backend = 0; Backend < Backend_Count; ++Backend)
+        {
+            for(u32 t = 0; t < IsaArrayLen(ThreadCounts); ++t)
+            {
+                if(t > 0 && ThreadCounts[t] == ThreadCounts[0])
+                {
+                    continue;
+                }
+
+                for(int Long = 0; Long < 2; ++Long)
+                {
+                    if(Target_File == Target)
+                    {
+                        if(0 != ftruncate(TargetFd, 0))
+                        {
+                            fprintf(stderr, "Could not truncate %s!\n", FilePath);
+                        }
+                        lseek(TargetFd, 0, SEEK_SET);
+                    }
+
+                    dup2(TargetFd, STDOUT_FILENO);
+                    bench_result Result;
+                    bool         Ran = Measure((bench_backend)Backend, Path, Long, Lines, ThreadCounts[t], Latencies,
+                                               &Result);
+                    dup2(StdoutFd, STDOUT_FILENO);
+
+                    if(Ran)
+                    {
+                        // NOTE(ingar): Dropped lines never reach the target, so
+                        // counting them would make a full ring look fast
+                        u64 Logged         = Lines * ThreadCounts[t];
+                        u64 Delivered      = Logged - IsaMin(Result.Dropped, Logged);
+                        f64 LinesPerSecond = (f64)Delivered / Result.Seconds;
+                        fprintf(Results, "%s,%s,%u,%s,%llu,%.6f,%.0f,%u,%u,%u,%u,%llu\n", BackendNames[Backend],
+                                TargetNames[Target], ThreadCounts[t], Long ? "long" : "short",
+                                (unsigned long long)Logged, Result.Seconds, LinesPerSecond, Result.P50, Result.P99,
+                                Result.P999, Result.Max, (unsigned long long)Result.Dropped);
+                        fflush(Results);
+                    }
+                }
+            }
+        }
+
+        close(TargetFd);
+        if(Target_Pipe == Target)
+        {
+            IsaThreadJoin(&Drainer);
+            close(PipeFds[0]);
+        }
+    }
+
+    fclose(Results);
+    free(Latencies);
+    remove(FilePath);
+
+    return 0;
+}
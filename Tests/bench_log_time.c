@@ -0,0 +1,116 @@
+/* Compares the cached timestamp prefix used by the logger against the old
+ * time() + localtime_r() + strftime() prefix, alone and as part of a full log
+ * line, on one thread and on several threads at once.
+ *
+ * Build: cc -O2 -pthread bench_log_time.c -o bench_log_time
+ * Usage: bench_log_time [lines per thread] [threads]
+ */
+
+#include "../isa.h"
+
+typedef u64 format_time_fn(char *__restrict Buffer, u64 BufferRemaining);
+
+typedef struct bench_job
+{
+    format_time_fn *FormatTime;
+    bool            FullLine;
+    u64             Lines;
+    u64             Sink;
+} bench_job;
+
+/* What the logger did before the timestamp cache */
+u64
+FormatTimeUncached(char *__restrict Buffer, u64 BufferRemaining)
+{
+    time_t    PosixTime;
+    struct tm TimeInfo;
+
+    time(&PosixTime);
+    localtime_r(&PosixTime, &TimeInfo);
+
+    u64 CharsWritten = strftime(Buffer, BufferRemaining, "%T: ", &TimeInfo);
+
+    return (0 == CharsWritten) ? (u64)-1 : CharsWritten;
+}
+
+f64
+NowSeconds(void)
+{
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (f64)Now.tv_sec + ((f64)Now.tv_nsec / 1e9);
+}
+
+void
+RunJob(void *Arg)
+{
+    bench_job *Job = (bench_job *)Arg;
+
+    char Buffer[ISA_LOG_BUF_SIZE];
+    u64  Sink = 0;
+    for(u64 i = 0; i < Job->Lines; ++i)
+    {
+        u64 Len = Job->FormatTime(Buffer, sizeof(Buffer));
+        if((u64)-1 == Len)
+        {
+            Len = 0;
+        }
+
+        if(Job->FullLine)
+        {
+            Len += (u64)snprintf(Buffer + Len, sizeof(Buffer) - Len, "%s: %s: request %llu took %d us\n", "Bench",
+                                 "INF", (unsigned long long)i, 42);
+        }
+        Sink += Len + (u8)Buffer[Len / 2];
+    }
+
+    Job->Sink = Sink;
+}
+
+f64
+Measure(format_time_fn *FormatTime, bool FullLine, u64 Lines, u32 ThreadCount)
+{
+    isa_thread Threads[64];
+    bench_job  Jobs[64];
+
+    f64 Start = NowSeconds();
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].FormatTime = FormatTime;
+        Jobs[i].FullLine   = FullLine;
+        Jobs[i].Lines      = Lines;
+        IsaThreadCreate(&Threads[i], RunJob, &Jobs[i]);
+    }
+
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        IsaThreadJoin(&Threads[i]);
+    }
+    f64 Elapsed = NowSeconds() - Start;
+
+    return ((f64)Lines * ThreadCount) / Elapsed;
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64 Lines       = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 2000000;
+    u32 ThreadCount = (ArgCount > 2) ? (u32)strtoul(Args[2], NULL, 10) : 4;
+    ThreadCount     = IsaMin(IsaMax(ThreadCount, 1u), 64u);
+
+    printf("%-10s %-8s %8s %16s %16s %8s\n", "work", "threads", "lines", "before lines/s", "after lines/s", "speedup");
+
+    u32 ThreadCounts[] = { 1, ThreadCount };
+    for(u32 t = 0; t < IsaArrayLen(ThreadCounts); ++t)
+    {
+        for(int FullLine = 0; FullLine < 2; ++FullLine)
+        {
+            f64 Before = Measure(FormatTimeUncached, FullLine, Lines, ThreadCounts[t]);
+            f64 After  = Measure(FormatTime, FullLine, Lines, ThreadCounts[t]);
+            printf("%-10s %-8u %8llu %16.0f %16.0f %7.2fx\n", FullLine ? "line" : "timestamp", ThreadCounts[t],
+                   (unsigned long long)Lines, Before, After, After / Before);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* Compares the atomic pool against the plain pool behind a mutex, which is
+ * what sharing a pool between threads took before. Every thread allocates a
+ * batch of items, writes to them and releases them again, over and over.
+ * Small batches stay within a thread's magazines, while big ones trade
+ * magazines with the depot. Thread counts double up to the number of cores.
+ * The allocs per thread are rounded up to a whole number of batches.
+ *
+ * Build: cc -O2 -pthread bench_pool.c -o bench_pool
+ * Usage: bench_pool [allocs per thread] [max threads]
+ */
+
+#include "../isa.h"
+
+typedef struct bench_item
+{
+    struct bench_item *Next;
+    u64                Data[3];
+} bench_item;
+
+ISA_DEFINE_POOL_ALLOCATOR(bench_item, Locked)
+ISA_DEFINE_ATOMIC_POOL_ALLOCATOR(bench_item, Atomic)
+
+typedef struct bench_job
+{
+    bool                    Atomic;
+    u32                     Batch;
+    u64                     Allocs;
+    bench_item_pool        *LockedPool;
+    isa_mutex              *Lock;
+    bench_item_atomic_pool *AtomicPool;
+    u64                     Sink;
+} bench_job;
+
+f64
+NowSeconds(void)
+{
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (f64)Now.tv_sec + ((f64)Now.tv_nsec / 1e9);
+}
+
+void
+RunJob(void *Arg)
+{
+    bench_job  *Job = (bench_job *)Arg;
+    bench_item *Items[1024];
+    u64         Sink = 0;
+    for(u64 Done = 0; Done < Job->Allocs; Done += Job->Batch)
+    {
+        for(u32 i = 0; i < Job->Batch; ++i)
+        {
+            if(Job->Atomic)
+            {
+                Items[i] = AtomicAlloc(Job->AtomicPool);
+            }
+            else
+            {
+                IsaMutexLock(Job->Lock);
+                Items[i] = LockedAlloc(Job->LockedPool);
+                IsaMutexUnlock(Job->Lock);
+            }
+
+            if(!Items[i])
+            {
+                fprintf(stderr, "The pool's arena ran out of memory!\n");
+                exit(1);
+            }
+            Items[i]->Data[0] = Done + i;
+        }
+
+        for(u32 i = 0; i < Job->Batch; ++i)
+        {
+            Sink += Items[i]->Data[0];
+            if(Job->Atomic)
+            {
+                AtomicRelease(Job->AtomicPool, Items[i]);
+            }
+            else
+            {
+                IsaMutexLock(Job->Lock);
+                LockedRelease(Job->LockedPool, Items[i]);
+                IsaMutexUnlock(Job->Lock);
+            }
+        }
+    }
+
+    if(Job->Atomic)
+    {
+        IsaAtomicPoolThreadFlush(&Job->AtomicPool->Base);
+    }
+    Job->Sink = Sink;
+}
+
+/**
+ * @return Allocs and releases per second, summed over all threads
+ */
+f64
+Measure(bool Atomic, u32 Batch, u64 Allocs, u32 ThreadCount)
+{
+    isa_thread Threads[256];
+    bench_job  Jobs[256];
+
+    // NOTE(ingar): Every run gets fresh pools, so none starts out with items
+    // the previous run released
+    isa_mutex              Lock        = ISA_MUTEX_INIT;
+    isa_arena             *Arena       = IsaArenaReserve(IsaGibiByte(1), 0);
+    isa_atomic_arena      *AtomicArena = IsaAtomicArenaCreate(IsaGibiByte(1), 0);
+    bench_item_pool        LockedPool  = { Arena, NULL };
+    bench_item_atomic_pool AtomicPool;
+    if(!Arena || !AtomicArena)
+    {
+        fprintf(stderr, "Could not reserve memory for the pools!\n");
+        exit(1);
+    }
+    AtomicInit(&AtomicPool, AtomicArena);
+
+    // NOTE(ingar): Threads work in whole batches, so this is what they really
+    // allocate
+    Allocs = ((Allocs + Batch - 1) / Batch) * Batch;
+
+    f64 Start = NowSeconds();
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].Atomic     = Atomic;
+        Jobs[i].Batch      = Batch;
+        Jobs[i].Allocs     = Allocs;
+        Jobs[i].LockedPool = &LockedPool;
+        Jobs[i].Lock       = &Lock;
+        Jobs[i].AtomicPool = &AtomicPool;
+        IsaThreadCreate(&Threads[i], RunJob, &Jobs[i]);
+    }
+
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        IsaThreadJoin(&Threads[i]);
+    }
+    f64 Elapsed = NowSeconds() - Start;
+
+    IsaArenaRelease(Arena);
+    IsaAtomicArenaRelease(AtomicArena);
+
+    return (2.0 * (f64)Allocs * ThreadCount) / Elapsed;
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64 Allocs     = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 4000000;
+    u32 MaxThreads = (ArgCount > 2) ? (u32)strtoul(Args[2], NULL, 10) : (u32)sysconf(_SC_NPROCESSORS_ONLN);
+    MaxThreads     = IsaMin(IsaMax(MaxThreads, 1u), 256u);
+
+    printf("%-6s %-8s %16s %16s %8s\n", "batch", "threads", "locked ops/s", "atomic ops/s", "speedup");
+
+    u32 Batches[] = { 8, 1024 };
+    for(u32 b = 0; b < IsaArrayLen(Batches); ++b)
+    {
+        for(u32 ThreadCount = 1;; ThreadCount *= 2)
+        {
+            ThreadCount = IsaMin(ThreadCount, MaxThreads);
+
+            f64 Locked = Measure(false, Batches[b], Allocs, ThreadCount);
+            f64 Atomic = Measure(true, Batches[b], Allocs, ThreadCount);
+            printf("%-6u %-8u %16.0f %16.0f %7.2fx\n", Batches[b], ThreadCount, Locked, Atomic, Atomic / Locked);
+
+            if(ThreadCount == MaxThreads)
+            {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
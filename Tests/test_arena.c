@@ -0,0 +1,305 @@
+/* Checks the arena on each kind of memory it can sit in: a contiguous block
+ * the caller owns, a reserved range and a chain of blocks. Aligned pushes must
+ * come back aligned, a reserved arena must commit as pushes reach it and
+ * decommit when it seeks back, popping what was pushed to a chained arena must
+ * land on the positions it had on the way up, even across blocks, nested temp
+ * scopes must each go back to where they began, and clearing a big reserved
+ * arena with IsaArenaClearZero must read back as zeros.
+ *
+ * Build: cc -O2 test_arena.c -o test_arena
+ * Usage: test_arena [pushes] [seed]
+ * Exits with 1 if anything went wrong.
+ */
+
+#include "../isa.h"
+
+#define ARENA_KIND_COUNT 3
+
+u64 RandomState;
+u64 Failures;
+
+u64
+Random(void)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return RandomState;
+}
+
+void
+Check(bool Ok, const char *Kind, const char *What)
+{
+    if(!Ok && Failures++ < 20)
+    {
+        printf("%s arena: %s\n", Kind, What);
+    }
+}
+
+/**
+ * @return A contiguous, reserved or chained arena, to be given back with
+ * ReleaseArena
+ */
+isa_arena *
+CreateArena(u32 Kind, const char **Name)
+{
+    switch(Kind)
+    {
+        case 0:
+        {
+            *Name = "contiguous";
+            return IsaArenaCreateContiguous(malloc(IsaMebiByte(16)), IsaMebiByte(16));
+        }
+        case 1:
+        {
+            *Name = "reserved";
+            return IsaArenaReserve(IsaGibiByte(1), ISA_ARENA_DECOMMIT);
+        }
+        default:
+        {
+            *Name = "chained";
+            return IsaArenaCreateChained(IsaKibiByte(4));
+        }
+    }
+}
+
+void
+ReleaseArena(isa_arena *Arena)
+{
+    if(Arena->Flags & (ISA_ARENA_RESERVED | ISA_ARENA_CHAINED))
+    {
+        IsaArenaRelease(Arena);
+    }
+    else
+    {
+        free(Arena);
+    }
+}
+
+void
+CheckAligned(isa_arena *Arena, const char *Kind, u64 Pushes)
+{
+    for(u64 i = 0; i < Pushes; ++i)
+    {
+        u64 Align = (u64)1 << (Random() % 13);
+        u64 Size  = Random() % 3000;
+        u8 *Mem   = (u8 *)IsaArenaPushAligned(Arena, Size, Align);
+        if(!Mem)
+        {
+            Check(false, Kind, "aligned push failed");
+            break;
+        }
+
+        Check(0 == ((uintptr_t)Mem & (Align - 1)), Kind, "aligned push is not aligned");
+        memset(Mem, 0xA5, Size);
+    }
+
+    u64 *Lines = IsaPushArrayAligned(Arena, u64, 9, ISA_CACHE_LINE_SIZE);
+    Check(0 == ((uintptr_t)Lines & (ISA_CACHE_LINE_SIZE - 1)), Kind, "IsaPushArrayAligned is not aligned");
+
+    IsaArenaClear(Arena);
+}
+
+/* Every push is filled with its own index and popped again in reverse, so the
+ * position after each pop must be the one before the push, and every push that
+ * is still there must hold what was written to it */
+void
+CheckPopRoundTrip(isa_arena *Arena, const char *Kind, u64 Pushes)
+{
+    u64  Base      = IsaArenaGetPos(Arena);
+    u64 *Positions = (u64 *)malloc(Pushes * sizeof(u64));
+    u64 *Sizes     = (u64 *)malloc(Pushes * sizeof(u64));
+    u8 **Mems      = (u8 **)malloc(Pushes * sizeof(u8 *));
+    for(u64 i = 0; i < Pushes; ++i)
+    {
+        // NOTE(ingar): The odd push is bigger than a chained arena's blocks
+        Positions[i] = IsaArenaGetPos(Arena);
+        Sizes[i]     = (0 == (i % 50)) ? (IsaKibiByte(6) + (Random() % 1000)) : (1 + (Random() % 700));
+        Mems[i]      = (u8 *)IsaArenaPush(Arena, Sizes[i]);
+        if(!Mems[i])
+        {
+            Check(false, Kind, "push failed");
+            Pushes = i;
+            break;
+        }
+
+        memset(Mems[i], (int)(i & 0xFF), Sizes[i]);
+        Check(IsaArenaGetPos(Arena) == (Positions[i] + Sizes[i]), Kind, "push moved the position by more than it");
+    }
+
+    for(u64 i = Pushes; i-- > 0;)
+    {
+        Check((Mems[i][0] == (u8)i) && (Mems[i][Sizes[i] - 1] == (u8)i), Kind, "push lost what was written to it");
+        IsaArenaPop(Arena, Sizes[i]);
+        Check(IsaArenaGetPos(Arena) == Positions[i], Kind, "pop did not go back to the position before the push");
+    }
+
+    Check(IsaArenaGetPos(Arena) == Base, Kind, "popping everything did not go back to the start");
+    Check(!Arena->Block || !Arena->Block->Prev, Kind, "popping everything did not go back to the first block");
+
+    // NOTE(ingar): Seeking back to a recorded position must work the same way
+    for(u64 i = 0; i < Pushes; ++i)
+    {
+        Mems[i] = (u8 *)IsaArenaPush(Arena, Sizes[i]);
+    }
+    for(u64 i = Pushes; i-- > 0;)
+    {
+        IsaArenaSeek(Arena, Positions[i]);
+        Check(IsaArenaGetPos(Arena) == Positions[i], Kind, "seek did not land on the position it was given");
+        // NOTE(ingar): A chained arena can get a different block back from
+        // the block cache, but the positions must not change
+        u8 *Again = (u8 *)IsaArenaPush(Arena, Sizes[i]);
+        Check((Arena->Flags & ISA_ARENA_CHAINED) || (Again == Mems[i]), Kind,
+              "push after a seek did not get the same memory");
+        Check(IsaArenaGetPos(Arena) == (Positions[i] + Sizes[i]), Kind, "push after a seek moved the position");
+        IsaArenaSeek(Arena, Positions[i]);
+    }
+
+    free(Positions);
+    free(Sizes);
+    free(Mems);
+    IsaArenaClear(Arena);
+}
+
+void
+CheckTempScopes(isa_arena *Arena, const char *Kind)
+{
+    u64            Outer[8];
+    isa_arena_temp Temps[8];
+    for(u32 i = 0; i < IsaArrayLen(Temps); ++i)
+    {
+        Outer[i] = IsaArenaGetPos(Arena);
+        Temps[i] = IsaArenaTempBegin(Arena);
+        IsaArenaPush(Arena, 1 + (Random() % IsaKibiByte(3)));
+        IsaArenaPushAligned(Arena, 8, 64);
+    }
+
+    for(u32 i = IsaArrayLen(Temps); i-- > 0;)
+    {
+        IsaArenaPush(Arena, Random() % 100);
+        IsaArenaTempEnd(Temps[i]);
+        Check(IsaArenaGetPos(Arena) == Outer[i], Kind, "temp scope did not go back to where it began");
+    }
+
+    Check(0 == Arena->TempDepth, Kind, "temp scopes are still counted as open");
+    IsaArenaClear(Arena);
+}
+
+void
+CheckReserved(void)
+{
+    u64        CommitSize = ISA_ARENA_COMMIT_SIZE;
+    isa_arena *Arena      = IsaArenaReserve(IsaGibiByte(1), ISA_ARENA_DECOMMIT);
+    if(!Arena)
+    {
+        Check(false, "reserved", "could not reserve");
+        return;
+    }
+
+    Check(Arena->Committed < CommitSize, "reserved", "committed more than one commit block up front");
+
+    u8 *Mem = (u8 *)IsaArenaPush(Arena, IsaMebiByte(3));
+    Check(Mem && (Arena->Committed >= IsaMebiByte(3)), "reserved", "push did not commit the memory it needed");
+    Check(Arena->Committed < (IsaMebiByte(3) + CommitSize), "reserved", "push committed more than it needed");
+    if(Mem)
+    {
+        memset(Mem, 0xCD, IsaMebiByte(3));
+    }
+
+    IsaArenaSeek(Arena, IsaKibiByte(4));
+    Check(Arena->Committed < CommitSize, "reserved", "seeking back did not decommit");
+    Check(Mem && (0xCD == Mem[IsaKibiByte(4) - 1]), "reserved", "seeking back lost memory below the position");
+
+    u8 *Again = (u8 *)IsaArenaPush(Arena, IsaMebiByte(2));
+    Check(Again && (Arena->Committed >= (IsaKibiByte(4) + IsaMebiByte(2))), "reserved",
+          "push after decommitting did not commit again");
+    if(Again)
+    {
+        memset(Again, 0xEF, IsaMebiByte(2));
+    }
+
+    IsaArenaRelease(Arena);
+
+    // NOTE(ingar): Without ISA_ARENA_DECOMMIT what was committed stays so
+    Arena = IsaArenaReserve(IsaGibiByte(1), 0);
+    if(Arena)
+    {
+        IsaArenaPush(Arena, IsaMebiByte(1));
+        u64 Committed = Arena->Committed;
+        IsaArenaClear(Arena);
+        Check(Arena->Committed == Committed, "reserved", "arena decommitted without ISA_ARENA_DECOMMIT");
+        IsaArenaRelease(Arena);
+    }
+}
+
+/* Big enough that IsaArenaClearZero drops the pages instead of writing them */
+void
+CheckClearZero(void)
+{
+    u64        Size  = 4 * ISA_ARENA_LAZY_ZERO_SIZE;
+    isa_arena *Arena = IsaArenaReserve(IsaGibiByte(1), 0);
+    if(!Arena)
+    {
+        Check(false, "reserved", "could not reserve");
+        return;
+    }
+
+    for(u32 Pass = 0; Pass < 3; ++Pass)
+    {
+        u8 *Mem = (u8 *)IsaArenaPush(Arena, Size);
+        if(!Mem)
+        {
+            Check(false, "reserved", "push failed");
+            break;
+        }
+
+        bool Zero = true;
+        for(u64 i = 0; i < Size; ++i)
+        {
+            Zero &= (0 == Mem[i]);
+        }
+        Check(Zero, "reserved", "memory did not read back as zeros after IsaArenaClearZero");
+
+        memset(Mem, 0x5A, Size);
+        IsaArenaClearZero(Arena);
+        Check(0 == IsaArenaGetPos(Arena), "reserved", "IsaArenaClearZero did not clear");
+    }
+
+    IsaArenaRelease(Arena);
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64 Pushes  = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 2000;
+    RandomState = (ArgCount > 2) ? strtoull(Args[2], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    RandomState = RandomState ? RandomState : 1;
+
+    for(u32 Kind = 0; Kind < ARENA_KIND_COUNT; ++Kind)
+    {
+        const char *Name  = NULL;
+        isa_arena  *Arena = CreateArena(Kind, &Name);
+        if(!Arena)
+        {
+            Check(false, Name, "could not be created");
+            continue;
+        }
+
+        CheckAligned(Arena, Name, Pushes);
+        CheckPopRoundTrip(Arena, Name, Pushes);
+        CheckTempScopes(Arena, Name);
+
+        // NOTE(ingar): Again from a position that is not the start
+        IsaArenaPush(Arena, 100);
+        CheckPopRoundTrip(Arena, Name, Pushes);
+        CheckTempScopes(Arena, Name);
+
+        ReleaseArena(Arena);
+    }
+
+    CheckReserved();
+    CheckClearZero();
+
+    printf("%llu pushes: %llu failures\n", (unsigned long long)Pushes, (unsigned long long)Failures);
+    return Failures ? 1 : 0;
+}
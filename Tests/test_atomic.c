@@ -0,0 +1,312 @@
+/* Checks the atomic arena and the atomic pool from many threads at once:
+ * pushes from different threads never overlap and are aligned, a pool item is
+ * never held by two threads at the same time, resetting hands out the arena
+ * from the start again and drops every thread's stale sub-blocks and
+ * magazines, and a thread's flushed magazines are handed out from the depot
+ * without going back to the arena.
+ *
+ * Build: cc -O2 -pthread test_atomic.c -o test_atomic
+ * Usage: test_atomic [threads] [rounds]
+ * Exits with 1 if anything went wrong.
+ */
+
+#include "../isa.h"
+
+#define MAX_THREADS      64
+#define PUSHES_PER_ROUND 4096
+
+typedef struct test_push
+{
+    u8 *Mem;
+    u64 Size;
+} test_push;
+
+typedef struct test_item
+{
+    volatile u64 Owner; /* Id of the thread holding the item, 0 when free */
+    u64          Data[3];
+} test_item;
+
+typedef struct test_job
+{
+    u64               Id;
+    u64               Rounds;
+    isa_atomic_arena *Arena;
+    isa_atomic_pool  *Pool;
+    test_push        *Pushes;
+    u64               PushCount;
+} test_job;
+
+u64 Failures;
+
+void
+Check(bool Ok, const char *What)
+{
+    if(!Ok && IsaAtomicAdd64(&Failures, 1) < 20)
+    {
+        printf("%s\n", What);
+    }
+}
+
+u64
+Random(u64 *State)
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 7;
+    *State ^= *State << 17;
+    return *State;
+}
+
+void
+PushJob(void *Arg)
+{
+    test_job *Job   = (test_job *)Arg;
+    u64       State = 0x9E3779B97F4A7C15ULL * Job->Id;
+    for(u64 i = 0; i < PUSHES_PER_ROUND; ++i)
+    {
+        // NOTE(ingar): Mostly small pushes that share sub-blocks, with the odd
+        // one big enough to go straight to the cursor
+        u64 Size  = (0 == (i % 64)) ? (IsaKibiByte(4) + (Random(&State) % 4096)) : (1 + (Random(&State) % 200));
+        u64 Align = (u64)1 << (Random(&State) % 7);
+        u8 *Mem   = (u8 *)IsaAtomicArenaPushAligned(Job->Arena, Size, Align);
+        if(!Mem)
+        {
+            break;
+        }
+
+        Check(0 == ((uintptr_t)Mem & (Align - 1)), "atomic arena push is not aligned");
+        memset(Mem, (int)Job->Id, Size);
+        Job->Pushes[Job->PushCount].Mem  = Mem;
+        Job->Pushes[Job->PushCount].Size = Size;
+        ++Job->PushCount;
+    }
+}
+
+int
+ComparePushes(const void *A, const void *B)
+{
+    const test_push *PushA = (const test_push *)A;
+    const test_push *PushB = (const test_push *)B;
+    return (PushA->Mem < PushB->Mem) ? -1 : (PushA->Mem > PushB->Mem);
+}
+
+void
+CheckArenaPushes(isa_atomic_arena *Arena, u32 ThreadCount)
+{
+    test_job   Jobs[MAX_THREADS];
+    isa_thread Threads[MAX_THREADS];
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].Id        = i + 1;
+        Jobs[i].Arena     = Arena;
+        Jobs[i].Pushes    = (test_push *)malloc(PUSHES_PER_ROUND * sizeof(test_push));
+        Jobs[i].PushCount = 0;
+        IsaThreadCreate(&Threads[i], PushJob, &Jobs[i]);
+    }
+
+    u64 PushCount = 0;
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        IsaThreadJoin(&Threads[i]);
+        PushCount += Jobs[i].PushCount;
+    }
+
+    // NOTE(ingar): Every byte still holds the id of the thread that pushed it,
+    // so a push another thread also got was overwritten by one of them
+    test_push *All = (test_push *)malloc(PushCount * sizeof(test_push));
+    u64        At  = 0;
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        for(u64 j = 0; j < Jobs[i].PushCount; ++j)
+        {
+            test_push *Push = &Jobs[i].Pushes[j];
+            for(u64 k = 0; k < Push->Size; ++k)
+            {
+                if(Push->Mem[k] != (u8)Jobs[i].Id)
+                {
+                    Check(false, "atomic arena push was written by another thread");
+                    break;
+                }
+            }
+            All[At++] = *Push;
+        }
+        free(Jobs[i].Pushes);
+    }
+
+    qsort(All, PushCount, sizeof(test_push), ComparePushes);
+    for(u64 i = 1; i < PushCount; ++i)
+    {
+        Check((All[i - 1].Mem + All[i - 1].Size) <= All[i].Mem, "atomic arena pushes overlap");
+    }
+    for(u64 i = 0; i < PushCount; ++i)
+    {
+        Check((All[i].Mem >= Arena->Mem) && ((All[i].Mem + All[i].Size) <= (Arena->Mem + Arena->Cap)),
+              "atomic arena push is outside the arena");
+    }
+    free(All);
+}
+
+void
+PoolJob(void *Arg)
+{
+    test_job  *Job = (test_job *)Arg;
+    test_item *Items[256];
+    u64        State = 0x2545F4914F6CDD1DULL * Job->Id;
+    for(u64 Round = 0; Round < Job->Rounds; ++Round)
+    {
+        u64 Batch = 1 + (Random(&State) % IsaArrayLen(Items));
+        u64 Count = 0;
+        for(; Count < Batch; ++Count)
+        {
+            Items[Count] = (test_item *)IsaAtomicPoolAlloc(Job->Pool);
+            if(!Items[Count])
+            {
+                break;
+            }
+
+            u64 Free = 0;
+            Check(IsaAtomicCompareExchange64(&Items[Count]->Owner, &Free, Job->Id),
+                  "atomic pool item was handed out twice");
+        }
+
+        for(u64 i = 0; i < Count; ++i)
+        {
+            Check(Job->Id == IsaAtomicLoad64(&Items[i]->Owner), "atomic pool item changed owner while held");
+            IsaAtomicStore64(&Items[i]->Owner, 0);
+            IsaAtomicPoolRelease(Job->Pool, Items[i]);
+        }
+    }
+
+    IsaAtomicPoolThreadFlush(Job->Pool);
+}
+
+void
+CheckPoolItems(isa_atomic_pool *Pool, u32 ThreadCount, u64 Rounds)
+{
+    test_job   Jobs[MAX_THREADS];
+    isa_thread Threads[MAX_THREADS];
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].Id     = i + 1;
+        Jobs[i].Rounds = Rounds;
+        Jobs[i].Pool   = Pool;
+        IsaThreadCreate(&Threads[i], PoolJob, &Jobs[i]);
+    }
+
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        IsaThreadJoin(&Threads[i]);
+    }
+}
+
+/* The calling thread holds a sub-block and magazines from before the reset,
+ * so anything it gets afterwards must come from the start of the arena */
+void
+CheckReset(isa_atomic_arena *Arena, isa_atomic_pool *Pool)
+{
+    test_item *First  = (test_item *)IsaAtomicPoolAlloc(Pool);
+    test_item *Second = (test_item *)IsaAtomicPoolAlloc(Pool);
+    IsaAtomicPoolRelease(Pool, Second);
+    IsaAtomicArenaPush(Arena, 100);
+    Check(First && Second && (IsaAtomicArenaGetUsed(Arena) > 0), "atomic arena was empty before the reset");
+
+    IsaAtomicPoolReset(Pool);
+    IsaAtomicArenaReset(Arena);
+    Check(0 == IsaAtomicArenaGetUsed(Arena), "atomic arena is not empty after the reset");
+
+    test_item *Item  = (test_item *)IsaAtomicPoolAlloc(Pool);
+    u8        *Start = (u8 *)IsaAlignUp((uintptr_t)Arena->Mem, ISA_ALIGNOF(test_item));
+    Check((u8 *)Item == Start, "atomic pool did not start over from the arena after the reset");
+    Check(Item != Second, "atomic pool handed out a magazine item from before the reset");
+    Check((u8 *)IsaAtomicArenaPush(Arena, 1) == (Start + sizeof(test_item)),
+          "atomic arena kept a sub-block from before the reset");
+
+    IsaAtomicPoolReset(Pool);
+    IsaAtomicArenaReset(Arena);
+}
+
+#define FLUSHED_ITEMS (2 * ISA_ATOMIC_POOL_MAGAZINE_SIZE)
+
+void
+FlushJob(void *Arg)
+{
+    test_job *Job = (test_job *)Arg;
+    for(u64 i = 0; i < FLUSHED_ITEMS; ++i)
+    {
+        Job->Pushes[i].Mem = (u8 *)IsaAtomicPoolAlloc(Job->Pool);
+    }
+    for(u64 i = 0; i < FLUSHED_ITEMS; ++i)
+    {
+        IsaAtomicPoolRelease(Job->Pool, Job->Pushes[i].Mem);
+    }
+
+    IsaAtomicPoolThreadFlush(Job->Pool);
+}
+
+/* A thread releases items into its magazines and flushes them before it
+ * exits. The calling thread, which has no magazines for the pool, must then
+ * get exactly those items without pushing anything to the arena */
+void
+CheckThreadFlush(isa_atomic_arena *Arena, isa_atomic_pool *Pool)
+{
+    test_push Released[FLUSHED_ITEMS];
+    test_job  Job;
+    Job.Pool   = Pool;
+    Job.Pushes = Released;
+
+    isa_thread Thread;
+    IsaThreadCreate(&Thread, FlushJob, &Job);
+    IsaThreadJoin(&Thread);
+
+    u64 Used = IsaAtomicArenaGetUsed(Arena);
+    for(u64 i = 0; i < FLUSHED_ITEMS; ++i)
+    {
+        u8  *Item  = (u8 *)IsaAtomicPoolAlloc(Pool);
+        bool Found = false;
+        for(u64 j = 0; j < FLUSHED_ITEMS; ++j)
+        {
+            if(Released[j].Mem == Item)
+            {
+                Released[j].Mem = NULL;
+                Found           = true;
+                break;
+            }
+        }
+        Check(Found, "atomic pool handed out an item that was not flushed to the depot");
+    }
+    Check(Used == IsaAtomicArenaGetUsed(Arena), "atomic pool went to the arena with flushed items in the depot");
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u32 ThreadCount = (ArgCount > 1) ? (u32)strtoul(Args[1], NULL, 10) : 8;
+    u64 Rounds      = (ArgCount > 2) ? strtoull(Args[2], NULL, 10) : 2000;
+    ThreadCount     = IsaMin(IsaMax(ThreadCount, 1U), (u32)MAX_THREADS);
+
+    isa_atomic_arena *Arena = IsaAtomicArenaCreate(IsaMebiByte(64), IsaKibiByte(16));
+    if(!Arena)
+    {
+        printf("could not create the atomic arena\n");
+        return 1;
+    }
+
+    isa_atomic_pool Pool;
+    IsaAtomicPoolInit(&Pool, Arena, sizeof(test_item), ISA_ALIGNOF(test_item));
+
+    // NOTE(ingar): The pool goes first, since its items are only free if the
+    // arena hands out zeroed memory, which it stops doing once it is reset
+    CheckPoolItems(&Pool, ThreadCount, Rounds);
+    CheckReset(Arena, &Pool);
+    CheckArenaPushes(Arena, ThreadCount);
+    CheckReset(Arena, &Pool);
+    CheckArenaPushes(Arena, ThreadCount);
+    CheckReset(Arena, &Pool);
+    CheckThreadFlush(Arena, &Pool);
+
+    IsaAtomicArenaRelease(Arena);
+
+    printf("%u threads, %llu rounds: %llu failures\n", ThreadCount, (unsigned long long)Rounds,
+           (unsigned long long)Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,497 @@
+/* Checks IsaFormat against the C library's snprintf on random combinations of
+ * flags, width, precision, length modifier, conversion and value, including
+ * output that has to be truncated, and on a few conversions too wide for the
+ * scratch buffer snprintf is called with. %r has no printf equivalent, so it is
+ * checked by reading every result back with strtod instead.
+ *
+ * Build: cc -O2 -pthread test_format.c -o test_format
+ * Usage: test_format [cases] [doubles] [seed]
+ * Exits with 1 if anything differed.
+ */
+
+#include "../isa.h"
+
+typedef enum test_kind
+{
+    Kind_Int,
+    Kind_Unsigned,
+    Kind_Char,
+    Kind_String,
+    Kind_Pointer,
+    Kind_Double,
+    Kind_Percent,
+} test_kind;
+
+typedef struct test_spec
+{
+    char      Format[64];
+    test_kind Kind;
+    char      Length[3];
+    u32       StarCount;
+    int       Stars[2];
+} test_spec;
+
+u64 RandomState;
+
+u64
+Random(void)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return RandomState;
+}
+
+u64
+RandomBelow(u64 Bound)
+{
+    return Random() % Bound;
+}
+
+/* Mostly random bits, which are mostly huge or tiny, mixed with the ordinary
+ * values logs are full of and the special ones */
+f64
+RandomDouble(void)
+{
+    u64 Bits  = Random();
+    f64 Value = 0.0;
+    switch(RandomBelow(6))
+    {
+        case 0:
+        case 1:
+        {
+            memcpy(&Value, &Bits, 8);
+        }
+        break;
+        case 2:
+        {
+            Value = (f64)(i64)(Bits % 2000001) - 1000000.0;
+        }
+        break;
+        case 3:
+        {
+            Value = ((f64)(Bits >> 11) / 9007199254740992.0) * 1000.0;
+        }
+        break;
+        case 4:
+        {
+            Value = ((f64)(i64)(Bits % 20001) - 10000.0) / 1000.0;
+        }
+        break;
+        case 5:
+        {
+            f64 Specials[] = { 0.0, -0.0, 0.5, 1.5, 2.5, 0.125, 1e-5, 9.5, 99.995, 1e22, 1e23, 5e-324,
+                               2.2250738585072014e-308, 1.7976931348623157e308, (f64)INFINITY, -(f64)INFINITY };
+
+            Value = Specials[Bits % IsaArrayLen(Specials)];
+        }
+        break;
+    }
+
+    return Value;
+}
+
+u64
+RandomInteger(void)
+{
+    u64 Value = Random();
+    switch(RandomBelow(4))
+    {
+        case 0:
+        {
+            Value &= 0xFF;
+        }
+        break;
+        case 1:
+        {
+            Value &= 0xFFFFF;
+        }
+        break;
+        case 2:
+        {
+            Value = (u64)0 - (Value & 0xFFF);
+        }
+        break;
+    }
+
+    return Value;
+}
+
+/* Only builds specs whose meaning the C standard defines, since anything else
+ * is allowed to differ */
+void
+RandomSpec(test_spec *Spec)
+{
+    const char *Conversions = "diuxXocspfFeEgG%";
+    char        Conversion  = Conversions[RandomBelow(strlen(Conversions))];
+
+    const char *Flags = "";
+    switch(Conversion)
+    {
+        case 'd':
+        case 'i':
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        {
+            Flags = "-+ 0";
+        }
+        break;
+        case 'u':
+        {
+            Flags = "-0";
+        }
+        break;
+        case 'x':
+        case 'X':
+        case 'o':
+        {
+            Flags = "-0#";
+        }
+        break;
+        case 'c':
+        case 's':
+        case 'p':
+        {
+            Flags = "-";
+        }
+        break;
+    }
+
+    char *At        = Spec->Format;
+    Spec->StarCount = 0;
+    *At++           = '%';
+
+    if('%' != Conversion)
+    {
+        for(const char *Flag = Flags; *Flag; ++Flag)
+        {
+            if(0 == RandomBelow(4))
+            {
+                *At++ = *Flag;
+            }
+        }
+        if(strchr("fFeEgG", Conversion) && 0 == RandomBelow(6))
+        {
+            *At++ = '#';
+        }
+
+        switch(RandomBelow(4))
+        {
+            case 0:
+            {
+                At += sprintf(At, "%u", (u32)RandomBelow(40));
+            }
+            break;
+            case 1:
+            {
+                *At++                          = '*';
+                Spec->Stars[Spec->StarCount++] = (int)RandomBelow(60) - 20;
+            }
+            break;
+        }
+
+        if(!strchr("cp", Conversion))
+        {
+            switch(RandomBelow(5))
+            {
+                case 0:
+                {
+                    At += sprintf(At, ".%u", (u32)RandomBelow(30));
+                }
+                break;
+                case 1:
+                {
+                    *At++ = '.';
+                }
+                break;
+                case 2:
+                {
+                    *At++                          = '.';
+                    *At++                          = '*';
+                    Spec->Stars[Spec->StarCount++] = (int)RandomBelow(40) - 5;
+                }
+                break;
+            }
+        }
+    }
+
+    Spec->Length[0] = '\0';
+    if(strchr("diuxXo", Conversion))
+    {
+        const char *Lengths[] = { "", "", "hh", "h", "l", "ll", "z", "j", "t" };
+        strcpy(Spec->Length, Lengths[RandomBelow(IsaArrayLen(Lengths))]);
+        At += sprintf(At, "%s", Spec->Length);
+    }
+
+    *At++ = Conversion;
+    *At   = '\0';
+
+    switch(Conversion)
+    {
+        case 'd':
+        case 'i':
+        {
+            Spec->Kind = Kind_Int;
+        }
+        break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        {
+            Spec->Kind = Kind_Unsigned;
+        }
+        break;
+        case 'c':
+        {
+            Spec->Kind = Kind_Char;
+        }
+        break;
+        case 's':
+        {
+            Spec->Kind = Kind_String;
+        }
+        break;
+        case 'p':
+        {
+            Spec->Kind = Kind_Pointer;
+        }
+        break;
+        case '%':
+        {
+            Spec->Kind = Kind_Percent;
+        }
+        break;
+        default:
+        {
+            Spec->Kind = Kind_Double;
+        }
+        break;
+    }
+}
+
+u64 Failures;
+
+void
+Check(u64 BufferSize, const char *Format, ...)
+{
+    char Expected[2048];
+    char Actual[2048];
+    memset(Expected, 'x', sizeof(Expected));
+    memset(Actual, 'x', sizeof(Actual));
+
+    va_list VaArgs, VaArgsCopy;
+    va_start(VaArgs, Format);
+    va_copy(VaArgsCopy, VaArgs);
+    int ExpectedLen = vsnprintf(Expected, BufferSize, Format, VaArgs);
+    i64 ActualLen   = IsaFormatV(Actual, BufferSize, Format, VaArgsCopy);
+    va_end(VaArgsCopy);
+    va_end(VaArgs);
+
+    u64  Compare = IsaMin(BufferSize, (u64)ExpectedLen + 1);
+    bool Same    = ((i64)ExpectedLen == ActualLen) && (0 == memcmp(Expected, Actual, Compare));
+    if(!Same && Failures++ < 20)
+    {
+        int Shown = (int)IsaMin(BufferSize, 200);
+        printf("\"%s\" in %llu bytes:\n  libc      %d \"%.*s\"\n  IsaFormat %lld \"%.*s\"\n", Format,
+               (unsigned long long)BufferSize, ExpectedLen, Shown, Expected, (long long)ActualLen, Shown, Actual);
+    }
+}
+
+/* Passes the star values, if any, ahead of the value */
+#define CHECK_SPEC(spec, size, value)                                                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(0 == (spec)->StarCount)                                                                                     \
+        {                                                                                                              \
+            Check(size, (spec)->Format, value);                                                                        \
+        }                                                                                                              \
+        else if(1 == (spec)->StarCount)                                                                                \
+        {                                                                                                              \
+            Check(size, (spec)->Format, (spec)->Stars[0], value);                                                      \
+        }                                                                                                              \
+        else                                                                                                           \
+        {                                                                                                              \
+            Check(size, (spec)->Format, (spec)->Stars[0], (spec)->Stars[1], value);                                    \
+        }                                                                                                              \
+    } while(0)
+
+void
+CheckInteger(test_spec *Spec, u64 Size, u64 Value)
+{
+    bool Signed = (Kind_Int == Spec->Kind);
+    if(0 == strcmp(Spec->Length, "l"))
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (long)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (unsigned long)Value);
+        }
+    }
+    else if(0 == strcmp(Spec->Length, "ll"))
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (long long)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (unsigned long long)Value);
+        }
+    }
+    else if(0 == strcmp(Spec->Length, "z"))
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (ptrdiff_t)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (size_t)Value);
+        }
+    }
+    else if(0 == strcmp(Spec->Length, "j"))
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (intmax_t)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (uintmax_t)Value);
+        }
+    }
+    else if(0 == strcmp(Spec->Length, "t"))
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (ptrdiff_t)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (size_t)Value);
+        }
+    }
+    else
+    {
+        if(Signed)
+        {
+            CHECK_SPEC(Spec, Size, (int)Value);
+        }
+        else
+        {
+            CHECK_SPEC(Spec, Size, (unsigned int)Value);
+        }
+    }
+}
+
+void
+CheckSpecs(u64 Cases)
+{
+    const char *Strings[] = { "", "a", "request", "hello, world", "tab\there", "a somewhat longer string value" };
+
+    for(u64 i = 0; i < Cases; ++i)
+    {
+        test_spec Spec;
+        RandomSpec(&Spec);
+
+        /* Mostly roomy buffers, but some that cut the output short */
+        u64 Size = (0 == RandomBelow(4)) ? RandomBelow(24) : 2048;
+
+        switch(Spec.Kind)
+        {
+            case Kind_Int:
+            case Kind_Unsigned:
+            {
+                CheckInteger(&Spec, Size, RandomInteger());
+            }
+            break;
+            case Kind_Char:
+            {
+                CHECK_SPEC(&Spec, Size, (int)(' ' + RandomBelow(95)));
+            }
+            break;
+            case Kind_String:
+            {
+                CHECK_SPEC(&Spec, Size, Strings[RandomBelow(IsaArrayLen(Strings))]);
+            }
+            break;
+            case Kind_Pointer:
+            {
+                CHECK_SPEC(&Spec, Size, (void *)(uintptr_t)(RandomBelow(8) ? Random() : 0));
+            }
+            break;
+            case Kind_Double:
+            {
+                CHECK_SPEC(&Spec, Size, RandomDouble());
+            }
+            break;
+            case Kind_Percent:
+            {
+                Check(Size, Spec.Format);
+            }
+            break;
+        }
+    }
+}
+
+/* Conversions that go through snprintf and come out longer than its 512 byte
+ * scratch buffer, which random widths never reach */
+void
+CheckWide(void)
+{
+    u64 Sizes[] = { 0, 1, 100, 511, 512, 600, 2048 };
+    for(u32 i = 0; i < IsaArrayLen(Sizes); ++i)
+    {
+        Check(Sizes[i], "ab%600e", 1.0);
+        Check(Sizes[i], "%-700.3g|", -2.5e-300);
+        Check(Sizes[i], "%+*E", 900, 6.02214076e23);
+        Check(Sizes[i], "x%.520e", 1.0 / 3.0);
+        Check(Sizes[i], "%650Lg", (long double)12.5);
+    }
+}
+
+void
+CheckShortest(u64 Doubles)
+{
+    char Buffer[64];
+    for(u64 i = 0; i < Doubles; ++i)
+    {
+        f64 Value = RandomDouble();
+        if(isnan(Value))
+        {
+            continue;
+        }
+
+        IsaFormat(Buffer, sizeof(Buffer), "%r", Value);
+        f64 ReadBack = strtod(Buffer, NULL);
+        if(0 != memcmp(&Value, &ReadBack, 8) && Failures++ < 20)
+        {
+            printf("%%r of %.17g gave \"%s\", which reads back as %.17g\n", Value, Buffer, ReadBack);
+        }
+    }
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    u64 Cases   = (ArgCount > 1) ? strtoull(Args[1], NULL, 10) : 400000;
+    u64 Doubles = (ArgCount > 2) ? strtoull(Args[2], NULL, 10) : 2000000;
+    RandomState = (ArgCount > 3) ? strtoull(Args[3], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    RandomState = RandomState ? RandomState : 1;
+
+    CheckSpecs(Cases);
+    CheckWide();
+    CheckShortest(Doubles);
+
+    printf("%llu specs, %llu doubles: %llu failures\n", (unsigned long long)Cases, (unsigned long long)Doubles,
+           (unsigned long long)Failures);
+    return Failures ? 1 : 0;
+}
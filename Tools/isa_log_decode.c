@@ -0,0 +1,400 @@
+/* Turns a log written with ISA_LOG_BINARY back into the text the logger would
+ * have printed, ordered by timestamp.
+ *
+ * Usage: isa_log_decode <log file> <call-site table>
+ */
+
+#define ISA_LOG_BINARY
+#include "../isa.h"
+
+typedef struct decode_site
+{
+    bool        Valid;
+    const char *LogLevel;
+    const char *ModuleName;
+    char       *Format;
+} decode_site;
+
+typedef struct decode_record
+{
+    u64 Timestamp;
+    u64 Offset;
+} decode_record;
+
+typedef struct decode_cursor
+{
+    const u8 *At;
+    const u8 *End;
+} decode_cursor;
+
+int
+CompareRecords(const void *A, const void *B)
+{
+    const decode_record *RecordA = (const decode_record *)A;
+    const decode_record *RecordB = (const decode_record *)B;
+    if(RecordA->Timestamp != RecordB->Timestamp)
+    {
+        return (RecordA->Timestamp < RecordB->Timestamp) ? -1 : 1;
+    }
+
+    return (RecordA->Offset < RecordB->Offset) ? -1 : 1;
+}
+
+char *
+SplitField(char **Cursor, char Separator)
+{
+    char *Field = *Cursor;
+    char *End   = strchr(Field, Separator);
+    if(End)
+    {
+        *End    = '\0';
+        *Cursor = End + 1;
+    }
+    else
+    {
+        *Cursor = Field + strlen(Field);
+    }
+
+    return Field;
+}
+
+void
+UnescapeInPlace(char *String)
+{
+    char *Out = String;
+    for(char *In = String; *In; ++In)
+    {
+        if('\\' == In[0] && In[1])
+        {
+            ++In;
+            *Out++ = ('n' == *In) ? '\n' : ('t' == *In) ? '\t' : *In;
+        }
+        else
+        {
+            *Out++ = *In;
+        }
+    }
+
+    *Out = '\0';
+}
+
+decode_site *
+LoadSiteTable(isa_file_data *Table, u32 *SiteCount)
+{
+    u32   MaxId  = 0;
+    char *Cursor = (char *)Table->Data;
+    while(*Cursor)
+    {
+        char *Line = SplitField(&Cursor, '\n');
+        u32   Id   = (u32)strtoul(Line, NULL, 10);
+        MaxId      = IsaMax(MaxId, Id);
+    }
+
+    decode_site *Sites = (decode_site *)calloc((u64)MaxId + 1, sizeof(decode_site));
+    if(!Sites)
+    {
+        return NULL;
+    }
+
+    /* SplitField null-terminated every line, so walk them by length. The next
+     * line is found before this one is split into fields and unescaped */
+    char *End = (char *)Table->Data + Table->Size;
+    char *Next;
+    for(char *Line = (char *)Table->Data; Line < End; Line = Next)
+    {
+        Next        = Line + strlen(Line) + 1;
+        char *Field = Line;
+        u32   Id    = (u32)strtoul(SplitField(&Field, '\t'), NULL, 10);
+        if(0 == Id || !*Field)
+        {
+            continue;
+        }
+
+        decode_site *Site = &Sites[Id];
+        Site->LogLevel    = SplitField(&Field, '\t');
+        Site->ModuleName  = SplitField(&Field, '\t');
+        SplitField(&Field, '\t'); /* File */
+        SplitField(&Field, '\t'); /* Line */
+        Site->Format = Field;
+        Site->Valid  = true;
+        UnescapeInPlace(Site->Format);
+    }
+
+    *SiteCount = MaxId + 1;
+    return Sites;
+}
+
+u64
+ReadU64(decode_cursor *Cursor)
+{
+    u64 Value = 0;
+    if((Cursor->End - Cursor->At) >= 8)
+    {
+        memcpy(&Value, Cursor->At, 8);
+        Cursor->At += 8;
+    }
+
+    return Value;
+}
+
+/* Formats with isa.h's engine, so extensions like %r decode the same way the
+ * text logger would have printed them */
+void
+PrintFormatted(const char *Format, ...)
+{
+    char    Buffer[1024];
+    va_list VaArgs, VaArgsCopy;
+    va_start(VaArgs, Format);
+    va_copy(VaArgsCopy, VaArgs);
+    i64 Len = IsaFormatV(Buffer, sizeof(Buffer), Format, VaArgs);
+    va_end(VaArgs);
+
+    /* Long strings and wide fields are formatted again into a buffer that
+     * fits them, so nothing is cut off */
+    char *Out = Buffer;
+    if(Len >= (i64)sizeof(Buffer))
+    {
+        Out = (char *)malloc((u64)Len + 1);
+        if(Out)
+        {
+            Len = IsaFormatV(Out, (u64)Len + 1, Format, VaArgsCopy);
+        }
+        else
+        {
+            Out = Buffer;
+            Len = sizeof(Buffer) - 1;
+        }
+    }
+    va_end(VaArgsCopy);
+
+    if(Len > 0)
+    {
+        fwrite(Out, 1, (u64)Len, stdout);
+    }
+
+    if(Out != Buffer)
+    {
+        free(Out);
+    }
+}
+
+void
+PrintSpec(const char *Spec, u64 SpecLen, u32 Kind, decode_cursor *Cursor)
+{
+    /* Width and precision stars are replaced by the recorded values */
+    char SpecBuf[128];
+    u64  SpecBufLen = 0;
+    for(u64 i = 0; i < SpecLen && SpecBufLen < (sizeof(SpecBuf) - 24); ++i)
+    {
+        if('*' == Spec[i])
+        {
+            SpecBufLen += (u64)snprintf(SpecBuf + SpecBufLen, 24, "%d", (int)ReadU64(Cursor));
+        }
+        else
+        {
+            SpecBuf[SpecBufLen++] = Spec[i];
+        }
+    }
+    SpecBuf[SpecBufLen] = '\0';
+
+    switch(Kind)
+    {
+        case ISA__LOG_ARG_NONE__:
+        {
+            putchar('%');
+        }
+        break;
+        case ISA__LOG_ARG_INT__:
+        {
+            PrintFormatted(SpecBuf, (int)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_LONG__:
+        {
+            PrintFormatted(SpecBuf, (long)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_LLONG__:
+        {
+            PrintFormatted(SpecBuf, (long long)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_SIZE__:
+        {
+            PrintFormatted(SpecBuf, (size_t)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_INTMAX__:
+        {
+            PrintFormatted(SpecBuf, (intmax_t)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_PTRDIFF__:
+        {
+            PrintFormatted(SpecBuf, (ptrdiff_t)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_DOUBLE__:
+        case ISA__LOG_ARG_LDOUBLE__:
+        {
+            u64 Bits = ReadU64(Cursor);
+            f64 Value;
+            memcpy(&Value, &Bits, 8);
+            if(ISA__LOG_ARG_LDOUBLE__ == Kind)
+            {
+                PrintFormatted(SpecBuf, (long double)Value);
+            }
+            else
+            {
+                PrintFormatted(SpecBuf, Value);
+            }
+        }
+        break;
+        case ISA__LOG_ARG_POINTER__:
+        {
+            PrintFormatted(SpecBuf, (void *)(uintptr_t)ReadU64(Cursor));
+        }
+        break;
+        case ISA__LOG_ARG_STRING__:
+        {
+            u32 Len = 0;
+            if((Cursor->End - Cursor->At) >= 4)
+            {
+                memcpy(&Len, Cursor->At, 4);
+                Cursor->At += 4;
+            }
+            Len = (u32)IsaMin((u64)Len, (u64)(Cursor->End - Cursor->At));
+
+            char *String = (char *)malloc((u64)Len + 1);
+            if(String)
+            {
+                memcpy(String, Cursor->At, Len);
+                String[Len] = '\0';
+                PrintFormatted(SpecBuf, String);
+                free(String);
+            }
+            Cursor->At += Len;
+        }
+        break;
+    }
+}
+
+void
+PrintRecord(decode_site *Site, u64 Timestamp, const u8 *Payload, u32 PayloadSize)
+{
+    time_t    Seconds = (time_t)(Timestamp / 1000000000ULL);
+    struct tm TimeInfo;
+#if defined(_WIN32) || defined(_WIN64)
+    localtime_s(&TimeInfo, &Seconds);
+#else
+    localtime_r(&Seconds, &TimeInfo);
+#endif
+
+    char TimeBuf[32];
+    strftime(TimeBuf, sizeof(TimeBuf), "%T", &TimeInfo);
+    printf("%s.%06u: %s: %s: ", TimeBuf, (u32)((Timestamp / 1000ULL) % 1000000ULL), Site->ModuleName,
+           Site->LogLevel);
+
+    decode_cursor   Cursor = { Payload, Payload + PayloadSize };
+    isa__log_spec__ Spec;
+    const char     *Literal = Site->Format;
+    const char     *Next    = Site->Format;
+    while((Next = Isa__LogNextSpec__(Next, &Spec)))
+    {
+        fwrite(Literal, 1, (u64)(Spec.Start - Literal), stdout);
+        PrintSpec(Spec.Start, Spec.Len, Spec.Kind, &Cursor);
+        Literal = Next;
+    }
+
+    fputs(Literal, stdout);
+    putchar('\n');
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    if(ArgCount != 3)
+    {
+        fprintf(stderr, "Usage: %s <log file> <call-site table>\n", Args[0]);
+        return 1;
+    }
+
+    isa_file_data *Log   = IsaLoadFileIntoMemory(Args[1]);
+    isa_file_data *Table = IsaLoadFileIntoMemory(Args[2]);
+    if(!Log || !Table)
+    {
+        return 1;
+    }
+
+    if(Log->Size < 16 || 0 != memcmp(Log->Data, ISA_LOG_BINARY_MAGIC, 8))
+    {
+        fprintf(stderr, "%s is not a binary isa log!\n", Args[1]);
+        return 1;
+    }
+
+    u32          SiteCount = 0;
+    decode_site *Sites     = LoadSiteTable(Table, &SiteCount);
+    if(!Sites)
+    {
+        fprintf(stderr, "Could not load call-site table!\n");
+        return 1;
+    }
+
+    u64 RecordCap = 0;
+    for(u64 Offset = 16; (Offset + 16) <= Log->Size; ++RecordCap)
+    {
+        u32 PayloadSize;
+        memcpy(&PayloadSize, Log->Data + Offset + 4, 4);
+        Offset += 16 + (u64)PayloadSize;
+    }
+
+    decode_record *Records = (decode_record *)calloc(RecordCap + 1, sizeof(decode_record));
+    if(!Records)
+    {
+        fprintf(stderr, "Could not allocate memory for records!\n");
+        return 1;
+    }
+
+    u64 RecordCount = 0;
+    for(u64 Offset = 16; (Offset + 16) <= Log->Size;)
+    {
+        u32 PayloadSize;
+        memcpy(&PayloadSize, Log->Data + Offset + 4, 4);
+        if((Offset + 16 + PayloadSize) > Log->Size)
+        {
+            fprintf(stderr, "Log is truncated at offset %llu\n", (unsigned long long)Offset);
+            break;
+        }
+
+        Records[RecordCount].Offset = Offset;
+        memcpy(&Records[RecordCount].Timestamp, Log->Data + Offset + 8, 8);
+        ++RecordCount;
+
+        Offset += 16 + (u64)PayloadSize;
+    }
+
+    qsort(Records, RecordCount, sizeof(decode_record), CompareRecords);
+
+    for(u64 i = 0; i < RecordCount; ++i)
+    {
+        const u8 *Record = Log->Data + Records[i].Offset;
+        u32       SiteId, PayloadSize;
+        memcpy(&SiteId, Record, 4);
+        memcpy(&PayloadSize, Record + 4, 4);
+
+        if(SiteId >= SiteCount || !Sites[SiteId].Valid)
+        {
+            printf("<unknown call site %u>\n", SiteId);
+            continue;
+        }
+
+        PrintRecord(&Sites[SiteId], Records[i].Timestamp, Record + 16, PayloadSize);
+    }
+
+    free(Records);
+    free(Sites);
+    free(Table);
+    free(Log);
+
+    return 0;
+}
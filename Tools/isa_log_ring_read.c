@@ -0,0 +1,158 @@
+/* Prints the records of a ring file written by IsaLogRingFileSinkCreate,
+ * oldest first. Works on rings left behind by a crashed process: torn or
+ * partially overwritten records fail their checksum and are skipped.
+ *
+ * Build: cc -O2 -pthread isa_log_ring_read.c -o isa_log_ring_read
+ * Usage: isa_log_ring_read <ring file>
+ */
+
+#include "../isa.h"
+
+typedef struct ring_entry
+{
+    u64 Seq;
+    u64 Offset;
+} ring_entry;
+
+int
+CompareEntries(const void *A, const void *B)
+{
+    const ring_entry *EntryA = (const ring_entry *)A;
+    const ring_entry *EntryB = (const ring_entry *)B;
+    if(EntryA->Seq != EntryB->Seq)
+    {
+        return (EntryA->Seq < EntryB->Seq) ? -1 : 1;
+    }
+
+    return (EntryA->Offset < EntryB->Offset) ? -1 : 1;
+}
+
+/**
+ * @return The record's size in the ring if there is a valid record at Offset,
+ * otherwise 0
+ */
+u64
+ValidRecordAt(const u8 *Records, u64 Capacity, u64 Offset)
+{
+    if((Offset + sizeof(isa_log_ring_record)) > Capacity)
+    {
+        return 0;
+    }
+
+    isa_log_ring_record Record;
+    memcpy(&Record, Records + Offset, sizeof(Record));
+    if(ISA_LOG_RING_RECORD_MAGIC != Record.Magic
+       || (Offset + sizeof(isa_log_ring_record) + (u64)Record.Len) > Capacity)
+    {
+        return 0;
+    }
+
+    if(Record.Checksum != IsaLogRingRecordChecksum(&Record, Records + Offset + sizeof(isa_log_ring_record)))
+    {
+        return 0;
+    }
+
+    return ISA__LOG_RING_ALIGN__(sizeof(isa_log_ring_record) + (u64)Record.Len);
+}
+
+int
+main(int ArgCount, char **Args)
+{
+    if(ArgCount != 2)
+    {
+        fprintf(stderr, "Usage: %s <ring file>\n", Args[0]);
+        return 1;
+    }
+
+    isa_file_data *Ring = IsaLoadFileIntoMemory(Args[1]);
+    if(!Ring)
+    {
+        return 1;
+    }
+
+    isa_log_ring_file_header Header;
+    if(Ring->Size < sizeof(Header))
+    {
+        fprintf(stderr, "%s is not an isa ring file!\n", Args[1]);
+        return 1;
+    }
+
+    memcpy(&Header, Ring->Data, sizeof(Header));
+    if(0 != memcmp(Header.Magic, ISA_LOG_RING_FILE_MAGIC, 8) || ISA_LOG_RING_FILE_VERSION != Header.Version
+       || (Header.HeaderSize + Header.Capacity) > Ring->Size || 0 != (Header.Capacity % 8))
+    {
+        fprintf(stderr, "%s is not an isa ring file, or it is truncated!\n", Args[1]);
+        return 1;
+    }
+
+    const u8 *Records  = Ring->Data + Header.HeaderSize;
+    u64       Capacity = Header.Capacity;
+
+    ring_entry *Entries = (ring_entry *)calloc((Capacity / sizeof(isa_log_ring_record)) + 1, sizeof(ring_entry));
+    if(!Entries)
+    {
+        fprintf(stderr, "Could not allocate memory for records!\n");
+        return 1;
+    }
+
+    /* Start where the next record would have gone, which is the oldest data,
+     * and walk the whole ring once. Where there is no valid record, resync by
+     * trying every 8-byte boundary */
+    u64 EntryCount = 0;
+    u64 Offset     = Header.Cursor % Capacity;
+    for(u64 Walked = 0; Walked < Capacity;)
+    {
+        u64 Size = ValidRecordAt(Records, Capacity, Offset);
+        if(0 == Size)
+        {
+            Size = 8;
+        }
+        else
+        {
+            isa_log_ring_record Record;
+            memcpy(&Record, Records + Offset, sizeof(Record));
+            if(!(Record.Flags & ISA_LOG_RING_RECORD_PAD))
+            {
+                Entries[EntryCount].Seq    = Record.Seq;
+                Entries[EntryCount].Offset = Offset;
+                ++EntryCount;
+            }
+        }
+
+        Walked += Size;
+        Offset += Size;
+        if(Offset >= Capacity)
+        {
+            Offset = 0;
+        }
+    }
+
+    /* The cursor is updated after the record it covers, so a crash can leave
+     * the newest record first in the walk. Sorting by sequence fixes that */
+    qsort(Entries, EntryCount, sizeof(ring_entry), CompareEntries);
+
+    u64 Gaps = 0;
+    for(u64 i = 0; i < EntryCount; ++i)
+    {
+        if(i > 0 && Entries[i].Seq == Entries[i - 1].Seq)
+        {
+            continue;
+        }
+        if(i > 0 && Entries[i].Seq != (Entries[i - 1].Seq + 1))
+        {
+            ++Gaps;
+        }
+
+        isa_log_ring_record Record;
+        memcpy(&Record, Records + Entries[i].Offset, sizeof(Record));
+        fwrite(Records + Entries[i].Offset + sizeof(isa_log_ring_record), 1, Record.Len, stdout);
+    }
+
+    fprintf(stderr, "%llu records, %llu gaps, next sequence number %llu\n", (unsigned long long)EntryCount,
+            (unsigned long long)Gaps, (unsigned long long)Header.NextSeq);
+
+    free(Entries);
+    free(Ring);
+
+    return 0;
+}
@@ -11,12 +11,30 @@
 
 #include <windows.h>
 
-#endif // Windows
+#elif defined(__linux__)
+
+// NOTE(ingar): Same as above, needed for localtime_r, clock_gettime and
+// friends when compiling with -std=c17
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#endif // Platform
 
 #include <assert.h>
 #include <float.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,6 +44,11 @@
 #include <stdbool.h>
 #endif // C/C++
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h> // NOTE(ingar): For the non-temporal stores in IsaMemZero
+#define ISA__HAS_SSE2__ 1
+#endif
+
 ////////////////////////////////////////
 //              DEFINES               //
 ////////////////////////////////////////
@@ -95,438 +118,7029 @@ typedef double f64;
 #define IsaMax(a, b) ((a > b) ? a : b)
 #define IsaMin(a, b) ((a < b) ? a : b)
 
+/* align must be a power of two */
+#define IsaIsPowerOfTwo(value)   ((value) && !((value) & ((value) - 1)))
+#define IsaAlignUp(value, align) (((value) + ((align) - 1)) & ~((u64)(align) - 1))
+
 #define isa_internal static
 #define isa_persist  static
 #define isa_global   static
 
-////////////////////////////////////////
-//              LOGGING               //
-////////////////////////////////////////
-/* Based on the logging frontend I wrote for oec */
-
-#if !defined(NDEBUG)
-
-#if !defined(ISA_LOG_BUF_SIZE)
-#define ISA_LOG_BUF_SIZE 128
+#if defined(__cplusplus)
+#define isa_thread_local thread_local
+#elif defined(_MSC_VER)
+#define isa_thread_local __declspec(thread)
+#else
+#define isa_thread_local _Thread_local
 #endif
 
-typedef struct isa__log_module__
-{
-    const char *Name;
-    u64         BufferSize;
-    char       *Buffer;
-} isa__log_module__;
+#if defined(__cplusplus)
+#define ISA_ALIGNOF(type) alignof(type)
+#elif defined(_MSC_VER)
+#define ISA_ALIGNOF(type) __alignof(type)
+#else
+#define ISA_ALIGNOF(type) _Alignof(type)
+#endif
 
-#if defined(_WIN32) || defined(_WIN64)
+#if defined(_MSC_VER)
+#define ISA_COLD        __declspec(noinline)
+#define ISA_NORETURN    __declspec(noreturn)
+#define ISA_UNUSED
+#define ISA_LIKELY(x)   (x)
+#define ISA_UNLIKELY(x) (x)
+#else
+#define ISA_COLD        __attribute__((cold, noinline))
+#define ISA_NORETURN    __attribute__((noreturn))
+#define ISA_UNUSED      __attribute__((unused))
+#define ISA_LIKELY(x)   __builtin_expect(!!(x), 1)
+#define ISA_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#endif
 
-// #define ISA_LOG_OUTPUTDEBUGSTRING
+#if !defined(ISA_CACHE_LINE_SIZE)
+#define ISA_CACHE_LINE_SIZE 64
+#endif
 
-#if defined(ISA_LOG_OUTPUTDEBUGSTRING)
-// TODO(ingar): OutputDebugString does not support formatting, so I need to find
-// some way to do that
-#define Isa__LogPrint__(string) OutputDebugStringA(string)
-#else
-#define Isa__LogPrint__(string) printf("%s", string)
+#if !defined(ISA_PAGE_SIZE)
+#define ISA_PAGE_SIZE 4096
 #endif
 
-u64
-Isa__FormatTimeWin32__(char *__restrict Buffer, u64 BufferRemaining)
-{
-    SYSTEMTIME Time;
-    GetLocalTime(&Time);
+////////////////////////////////////////
+//              ATOMICS               //
+////////////////////////////////////////
+/* Loads are acquire, stores are release and read-modify-writes are
+ * sequentially consistent unless the name says otherwise */
 
-    int CharsWritten = snprintf(Buffer, BufferRemaining, "%04d-%02d-%02d %02d:%02d:%02d: ", Time.wYear, Time.wMonth,
-                                Time.wDay, Time.wHour, Time.wMinute, Time.wSecond);
+#if defined(_MSC_VER)
 
-    return (CharsWritten < 0) ? -1 : CharsWritten;
+u32
+IsaAtomicLoad32(volatile u32 *Ptr)
+{
+    u32 Value = *Ptr;
+    _ReadWriteBarrier();
+    return Value;
 }
-#define FormatTime Isa__FormatTimeWin32__
 
-#elif defined(__linux__)
+u64
+IsaAtomicLoad64(volatile u64 *Ptr)
+{
+    u64 Value = *Ptr;
+    _ReadWriteBarrier();
+    return Value;
+}
 
-#define Isa__LogPrint__(string) printf("%s", string)
+u32
+IsaAtomicLoadRelaxed32(volatile u32 *Ptr)
+{
+    return *Ptr;
+}
 
 void
-Isa__FormatTimePosix__(char *__restrict Buffer, u64 BufferRemaining)
+IsaAtomicStore32(volatile u32 *Ptr, u32 Value)
 {
-    time_t    PosixTime;
-    struct tm TimeInfo;
-
-    time(&PosixTime);
-    localtime_r(&PosixTime, &TimeInfo);
-
-    u64 CharsWritten = strftime(Buffer, BufferRemaining, "%T: ", &TimeInfo);
+    _ReadWriteBarrier();
+    *Ptr = Value;
+}
 
-    return (0 == CharsWritten) ? -1 : CharsWritten;
+void
+IsaAtomicStore64(volatile u64 *Ptr, u64 Value)
+{
+    _ReadWriteBarrier();
+    *Ptr = Value;
 }
-#define FormatTime              Isa__FormatTimePosix__
-#elif defined(__APPLE__) && defined(__MACH__)
-#endif // Platform
 
-i64
-Isa__WriteLog__(isa__log_module__ *Module, const char *LogLevel, va_list VaArgs)
+u64
+IsaAtomicAdd64(volatile u64 *Ptr, u64 Value)
 {
-    u64 BufferRemaining = Module->BufferSize;
-    u64 CharsWritten    = FormatTime(Module->Buffer, BufferRemaining);
-    if((CharsWritten < 0) || (CharsWritten >= BufferRemaining))
-    {
-        return -1;
-    }
+    return (u64)InterlockedExchangeAdd64((volatile LONG64 *)Ptr, (LONG64)Value);
+}
 
-    BufferRemaining -= CharsWritten;
+u64
+IsaAtomicAddRelaxed64(volatile u64 *Ptr, u64 Value)
+{
+    return (u64)InterlockedExchangeAddNoFence64((volatile LONG64 *)Ptr, (LONG64)Value);
+}
 
-    i64 Ret = snprintf(Module->Buffer + CharsWritten, BufferRemaining, "%s: %s: ", Module->Name, LogLevel);
-    if((Ret < 0) || (Ret >= (i64)BufferRemaining))
+bool
+IsaAtomicCompareExchange64(volatile u64 *Ptr, u64 *Expected, u64 Desired)
+{
+    u64 Previous = (u64)InterlockedCompareExchange64((volatile LONG64 *)Ptr, (LONG64)Desired, (LONG64)*Expected);
+    if(Previous == *Expected)
     {
-        return -1;
+        return true;
     }
 
-    CharsWritten += Ret;
-    BufferRemaining -= Ret;
+    *Expected = Previous;
+    return false;
+}
 
-    const char *FormatString = va_arg(VaArgs, const char *);
-    Ret                      = vsnprintf(Module->Buffer + CharsWritten, BufferRemaining, FormatString, VaArgs);
+void *
+IsaAtomicLoadPtr(void *volatile *Ptr)
+{
+    void *Value = *Ptr;
+    _ReadWriteBarrier();
+    return Value;
+}
 
-    if(Ret < 0)
-    {
-        return -1;
-    }
+void *
+IsaAtomicExchangePtr(void *volatile *Ptr, void *Value)
+{
+    return InterlockedExchangePointer(Ptr, Value);
+}
 
-    if(Ret >= (i64)BufferRemaining)
-    {
-        Module->Buffer[Module->BufferSize - 2] = '\n';
-    }
-    else
+bool
+IsaAtomicCompareExchangePtr(void *volatile *Ptr, void **Expected, void *Desired)
+{
+    void *Previous = InterlockedCompareExchangePointer(Ptr, Desired, *Expected);
+    if(Previous == *Expected)
     {
-        CharsWritten += Ret;
-        if(CharsWritten < (Module->BufferSize - 1))
-        {
-            Module->Buffer[CharsWritten]     = '\n';
-            Module->Buffer[CharsWritten + 1] = '\0';
-        }
-        else
-        {
-            Module->Buffer[Module->BufferSize - 2] = '\n';
-            Module->Buffer[Module->BufferSize - 1] = '\0';
-        }
+        return true;
     }
 
-    Isa__LogPrint__(Module->Buffer);
-    return 0;
+    *Expected = Previous;
+    return false;
 }
 
-i64
-Isa__WriteLogIntermediate__(isa__log_module__ *Module, const char *LogLevel, ...)
+void
+IsaAtomicFence(void)
 {
-    va_list VaArgs;
-    va_start(VaArgs, LogLevel);
-    i64 Ret = Isa__WriteLog__(Module, LogLevel, VaArgs);
-    va_end(VaArgs);
-    return Ret;
+    MemoryBarrier();
 }
 
-i64
-Isa__WriteLogNoModule__(const char *LogLevel, const char *FunctionName, ...)
-{
-    char             *Buffer = (char *)calloc(ISA_LOG_BUF_SIZE, sizeof(char));
-    isa__log_module__ Module = {
-        .Name       = FunctionName,
-        .BufferSize = ISA_LOG_BUF_SIZE,
-        .Buffer     = Buffer,
-    };
-
-    va_list VaArgs;
-    va_start(VaArgs, FunctionName);
-
-    i64 Ret = Isa__WriteLog__(&Module, LogLevel, VaArgs);
+#else // GCC/Clang
 
-    va_end(VaArgs);
-    free(Buffer);
+u32
+IsaAtomicLoad32(volatile u32 *Ptr)
+{
+    return __atomic_load_n(Ptr, __ATOMIC_ACQUIRE);
+}
 
-    return Ret;
+u64
+IsaAtomicLoad64(volatile u64 *Ptr)
+{
+    return __atomic_load_n(Ptr, __ATOMIC_ACQUIRE);
 }
 
-#if !defined(ISA_LOG_LEVEL)
-#define ISA_LOG_LEVEL 4
-#endif
+u32
+IsaAtomicLoadRelaxed32(volatile u32 *Ptr)
+{
+    return __atomic_load_n(Ptr, __ATOMIC_RELAXED);
+}
 
-#define ISA_LOG_LEVEL_NONE (0U)
-#define ISA_LOG_LEVEL_ERR  (1U)
-#define ISA_LOG_LEVEL_WRN  (2U)
-#define ISA_LOG_LEVEL_INF  (3U)
-#define ISA_LOG_LEVEL_DBG  (4U)
+void
+IsaAtomicStore32(volatile u32 *Ptr, u32 Value)
+{
+    __atomic_store_n(Ptr, Value, __ATOMIC_RELEASE);
+}
 
-#define ISA__LOG_LEVEL_CHECK__(level) (ISA_LOG_LEVEL >= ISA_LOG_LEVEL_##level ? 1 : 0)
+void
+IsaAtomicStore64(volatile u64 *Ptr, u64 Value)
+{
+    __atomic_store_n(Ptr, Value, __ATOMIC_RELEASE);
+}
 
-#if !defined(ISA_LOG_OVERRIDE)
-#define ISA_LOG_REGISTER(module_name)                                                                                  \
-    isa_global char              Isa__LogBuffer__[ISA_LOG_BUF_SIZE];                                                   \
-    isa_global isa__log_module__ ISA_CONCAT3(Isa__LogModule, module_name, __)                                          \
-        = { .Name = #module_name, .BufferSize = ISA_LOG_BUF_SIZE, .Buffer = Isa__LogBuffer__ };                        \
-    isa_global isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, module_name, __)
+u64
+IsaAtomicAdd64(volatile u64 *Ptr, u64 Value)
+{
+    return __atomic_fetch_add(Ptr, Value, __ATOMIC_SEQ_CST);
+}
 
-#define ISA_LOG_DECLARE_EXTERN(name)                                                                                   \
-    extern isa__log_module__      ISA_CONCAT3(Isa__LogModule, name, __);                                               \
-    isa_global isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, name, __)
+u64
+IsaAtomicAddRelaxed64(volatile u64 *Ptr, u64 Value)
+{
+    return __atomic_fetch_add(Ptr, Value, __ATOMIC_RELAXED);
+}
 
-#else /* ISA_LOG_OVERRIDE */
-/* This allows files with different module names to be included in the same TU
- * by overriding their module names */
+bool
+IsaAtomicCompareExchange64(volatile u64 *Ptr, u64 *Expected, u64 Desired)
+{
+    return __atomic_compare_exchange_n(Ptr, Expected, Desired, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+}
 
-#define ISA_LOG_REGISTER_OVERRIDE(module_name)                                                                         \
-    isa_global char              Isa__LogBuffer__[ISA_LOG_BUF_SIZE];                                                   \
-    isa_global isa__log_module__ ISA_CONCAT3(Isa__LogModule, module_name, __)                                          \
-        = { .Name = #module_name, .BufferSize = ISA_LOG_BUF_SIZE, .Buffer = Isa__LogBuffer__ };                        \
-    isa_global isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, module_name, __)
+void *
+IsaAtomicLoadPtr(void *volatile *Ptr)
+{
+    return __atomic_load_n(Ptr, __ATOMIC_ACQUIRE);
+}
 
-#define ISA_LOG_REGISTER(name)       extern isa__log_module__ *Isa__LogInstance__
-#define ISA_LOG_DECLARE_EXTERN(name) extern isa__log_module__ *Isa__LogInstance__
+void *
+IsaAtomicExchangePtr(void *volatile *Ptr, void *Value)
+{
+    return __atomic_exchange_n(Ptr, Value, __ATOMIC_ACQ_REL);
+}
 
-#endif /* ISA_LOG_OVERRIDE */
+bool
+IsaAtomicCompareExchangePtr(void *volatile *Ptr, void **Expected, void *Desired)
+{
+    return __atomic_compare_exchange_n(Ptr, Expected, Desired, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+}
 
-#define ISA_LOG_DECLARE_SAME_TU extern struct isa__log_module__ *Isa__LogInstance__
+void
+IsaAtomicFence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
 
-#define ISA__LOG__(log_level, ...)                                                                                     \
-    do                                                                                                                 \
-    {                                                                                                                  \
-        if(ISA__LOG_LEVEL_CHECK__(log_level))                                                                          \
-        {                                                                                                              \
-            i64 Ret = Isa__WriteLogIntermediate__(Isa__LogInstance__, ISA_STRINGIFY(log_level), __VA_ARGS__);          \
-            if(Ret)                                                                                                    \
-            {                                                                                                          \
-                Isa__LogPrint__("\n\nERROR WHILE LOGGING\n\n");                                                        \
-                assert(0);                                                                                             \
-            }                                                                                                          \
-        }                                                                                                              \
-    } while(0)
+#endif // Compiler
 
-#define ISA__LOG_NO_MODULE__(log_level, ...)                                                                           \
-    do                                                                                                                 \
-    {                                                                                                                  \
-        if(ISA__LOG_LEVEL_CHECK__(log_level))                                                                          \
-        {                                                                                                              \
-            i64 Ret = Isa__WriteLogNoModule__(ISA_STRINGIFY(log_level), __func__, __VA_ARGS__);                        \
-            if(Ret)                                                                                                    \
-            {                                                                                                          \
-                Isa__LogPrint__("\n\nERROR WHILE LOGGING\n\n");                                                        \
-                assert(0);                                                                                             \
-            }                                                                                                          \
-        }                                                                                                              \
-    } while(0)
+////////////////////////////////////////
+//              THREADS               //
+////////////////////////////////////////
 
-#define IsaLogDebug(...)   ISA__LOG__(DBG, __VA_ARGS__)
-#define IsaLogInfo(...)    ISA__LOG__(INF, __VA_ARGS__)
-#define IsaLogWarning(...) ISA__LOG__(WRN, __VA_ARGS__)
-#define IsaLogError(...)   ISA__LOG__(ERR, __VA_ARGS__)
+typedef void isa_thread_proc(void *Arg);
 
-#define IsaLogDebugNoModule(...)   ISA__LOG_NO_MODULE__(DBG, __VA_ARGS__)
-#define IsaLogInfoNoModule(...)    ISA__LOG_NO_MODULE__(INF, __VA_ARGS__)
-#define IsaLogWarningNoModule(...) ISA__LOG_NO_MODULE__(WRN, __VA_ARGS__)
-#define IsaLogErrorNoModule(...)   ISA__LOG_NO_MODULE__(ERR, __VA_ARGS__)
+typedef struct isa_thread
+{
+    isa_thread_proc *Proc;
+    void            *Arg;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE Handle;
+#else
+    pthread_t Handle;
+#endif
+} isa_thread;
 
-#define IsaAssert(condition)                                                                                           \
-    do                                                                                                                 \
-    {                                                                                                                  \
-        if(!(condition))                                                                                               \
-        {                                                                                                              \
-            ISA__LOG_NO_MODULE__(ERR, "Assertion failed: " ISA_STRINGIFY(condition));                                  \
-            assert(condition);                                                                                         \
-        }                                                                                                              \
-    } while(0)
+typedef struct isa_mutex
+{
+#if defined(_WIN32) || defined(_WIN64)
+    SRWLOCK Handle;
+#else
+    pthread_mutex_t Handle;
+#endif
+} isa_mutex;
 
-#endif // NDEBUG
+#if defined(_WIN32) || defined(_WIN64)
 
-////////////////////////////////////////
-//               MISC                 //
-////////////////////////////////////////
+DWORD WINAPI
+Isa__ThreadEntry__(LPVOID Param)
+{
+    isa_thread *Thread = (isa_thread *)Param;
+    Thread->Proc(Thread->Arg);
+    return 0;
+}
 
+/**
+ * @note Thread must stay valid until IsaThreadJoin has returned
+ */
 bool
-IsaDoubleEpsilonCompare(const double A, const double B)
+IsaThreadCreate(isa_thread *Thread, isa_thread_proc *Proc, void *Arg)
 {
-    double GreatestValue = (fabs(A) < fabs(B)) ? fabs(B) : fabs(A);
-    return fabs(A - B) <= (GreatestValue * DBL_EPSILON);
+    Thread->Proc   = Proc;
+    Thread->Arg    = Arg;
+    Thread->Handle = CreateThread(NULL, 0, Isa__ThreadEntry__, Thread, 0, NULL);
+    return NULL != Thread->Handle;
 }
 
-u64
-IsaDoubleSignBit(double F)
+void
+IsaThreadJoin(isa_thread *Thread)
 {
-    u64  Mask = 1ULL << 63;
-    u64 *Comp = (u64 *)&F;
-
-    return (*Comp) & Mask;
+    WaitForSingleObject(Thread->Handle, INFINITE);
+    CloseHandle(Thread->Handle);
 }
 
-double
-IsaRadiansFromDegrees(double Degrees)
+void
+IsaSleepMicroseconds(u64 Microseconds)
 {
-    double Radians = 0.01745329251994329577f * Degrees;
-    return Radians;
+    // NOTE(ingar): Sleep has millisecond granularity, so anything shorter
+    // becomes a yield
+    Sleep((DWORD)(Microseconds / 1000));
 }
 
-////////////////////////////////////////
-//               MEMORY               //
-////////////////////////////////////////
+#define ISA_MUTEX_INIT { SRWLOCK_INIT }
 
 void
-IsaMemZero(void *Mem, u64 Size)
+IsaMutexInit(isa_mutex *Mutex)
 {
-    for(u64 i = 0; i < Size; ++i)
-    {
-        ((u8 *)Mem)[i] = 0;
-    }
+    InitializeSRWLock(&Mutex->Handle);
 }
 
-void /* From https://github.com/BLAKE2/BLAKE2/blob/master/ref/blake2-impl.h */
-IsaMemZeroSecure(void *Mem, u64 Size)
+void
+IsaMutexLock(isa_mutex *Mutex)
 {
-    static void *(*const volatile memset_v)(void *, int, u64) = &memset;
-    (void)memset_v(Mem, 0, Size);
+    AcquireSRWLockExclusive(&Mutex->Handle);
 }
 
-#define IsaMemZeroStruct(struct)       IsaMemZero(struct, sizeof(*struct))
-#define IsaMemZeroStructSecure(struct) IsaMemZeroSecure(struct, sizeof(*struct))
+bool
+IsaMutexTryLock(isa_mutex *Mutex)
+{
+    return TryAcquireSRWLockExclusive(&Mutex->Handle);
+}
+
+void
+IsaMutexUnlock(isa_mutex *Mutex)
+{
+    ReleaseSRWLockExclusive(&Mutex->Handle);
+}
+
+#else // POSIX
+
+void *
+Isa__ThreadEntry__(void *Param)
+{
+    isa_thread *Thread = (isa_thread *)Param;
+    Thread->Proc(Thread->Arg);
+    return NULL;
+}
+
+/**
+ * @note Thread must stay valid until IsaThreadJoin has returned
+ */
+bool
+IsaThreadCreate(isa_thread *Thread, isa_thread_proc *Proc, void *Arg)
+{
+    Thread->Proc = Proc;
+    Thread->Arg  = Arg;
+    return 0 == pthread_create(&Thread->Handle, NULL, Isa__ThreadEntry__, Thread);
+}
+
+void
+IsaThreadJoin(isa_thread *Thread)
+{
+    pthread_join(Thread->Handle, NULL);
+}
+
+void
+IsaSleepMicroseconds(u64 Microseconds)
+{
+    struct timespec Duration;
+    Duration.tv_sec  = (time_t)(Microseconds / 1000000);
+    Duration.tv_nsec = (long)((Microseconds % 1000000) * 1000);
+    nanosleep(&Duration, NULL);
+}
+
+#define ISA_MUTEX_INIT { PTHREAD_MUTEX_INITIALIZER }
+
+void
+IsaMutexInit(isa_mutex *Mutex)
+{
+    pthread_mutex_init(&Mutex->Handle, NULL);
+}
+
+void
+IsaMutexLock(isa_mutex *Mutex)
+{
+    pthread_mutex_lock(&Mutex->Handle);
+}
+
+bool
+IsaMutexTryLock(isa_mutex *Mutex)
+{
+    return 0 == pthread_mutex_trylock(&Mutex->Handle);
+}
+
+void
+IsaMutexUnlock(isa_mutex *Mutex)
+{
+    pthread_mutex_unlock(&Mutex->Handle);
+}
+
+#endif // Platform
+
+////////////////////////////////////////
+//               FORMAT               //
+////////////////////////////////////////
+
+/* A printf replacement for the conversions logging actually uses. Integers are
+ * converted two digits at a time from a lookup table, %f is computed exactly
+ * in 128-bit fixed point (so it matches glibc digit for digit), and the rest
+ * of printf falls back to snprintf. Extensions:
+ *
+ *   %S  isa_string, passed by value; a precision limits the length as for %s
+ *   %r  double, the shortest digits that read back as the same value (Grisu2)
+ *
+ * Supported: flags "-+ 0#", width and precision (including '*'), length
+ * modifiers hh h l ll z j t, and the conversions d i u x X o c s p f F r %.
+ * e E g G a A and long double go through snprintf */
+
+// NOTE(ingar): isa_string lives with the other memory types further down in
+// spirit, but formatting needs its layout
+typedef struct isa_string
+{
+    u64         Len; /* Does not include the null terminator*/
+    const char *S;   /* Will always be null-terminated for simplicity */
+} isa_string;
+
+/* Counts every byte put, but only writes the ones that fit, so the caller
+ * learns the full length like with snprintf and can retry with a bigger
+ * buffer. A writer with Grow set instead asks for more room when a put does
+ * not fit, so the output is formatted once no matter how long it gets */
+typedef struct isa__format_writer__ isa__format_writer__;
+
+/* Must keep the first Writer->Len bytes and update Buffer and Cap. Returns
+ * false if Cap could not reach Size, in which case it may still have grown */
+typedef bool isa__format_grow_fn__(isa__format_writer__ *Writer, u64 Size);
+
+struct isa__format_writer__
+{
+    char                  *Buffer;
+    u64                    Cap;
+    u64                    Len;
+    isa__format_grow_fn__ *Grow; /* Optional */
+};
+
+/**
+ * @brief Called when Len more bytes do not fit
+ * @return Whether they fit now. Once growing fails the writer stops trying and
+ * truncates like a plain writer
+ */
+ISA_COLD bool
+Isa__FormatGrow__(isa__format_writer__ *Writer, u64 Len)
+{
+    // NOTE(ingar): Once anything has been cut off, the rest can not be kept
+    // even if the buffer grows
+    if(!Writer->Grow || Writer->Len > Writer->Cap)
+    {
+        return false;
+    }
+
+    if(Writer->Grow(Writer, Writer->Len + Len))
+    {
+        return true;
+    }
+
+    Writer->Grow = NULL;
+    return false;
+}
+
+void
+Isa__FormatPut__(isa__format_writer__ *Writer, const char *Data, u64 Len)
+{
+    if(((Writer->Len + Len) <= Writer->Cap) || Isa__FormatGrow__(Writer, Len))
+    {
+        memcpy(Writer->Buffer + Writer->Len, Data, Len);
+    }
+    else if(Writer->Len < Writer->Cap)
+    {
+        memcpy(Writer->Buffer + Writer->Len, Data, Writer->Cap - Writer->Len);
+    }
+    Writer->Len += Len;
+}
+
+void
+Isa__FormatPutChar__(isa__format_writer__ *Writer, char Char)
+{
+    if((Writer->Len < Writer->Cap) || Isa__FormatGrow__(Writer, 1))
+    {
+        Writer->Buffer[Writer->Len] = Char;
+    }
+    ++Writer->Len;
+}
+
+void
+Isa__FormatPutRepeated__(isa__format_writer__ *Writer, char Char, u64 Count)
+{
+    if(((Writer->Len + Count) <= Writer->Cap) || Isa__FormatGrow__(Writer, Count))
+    {
+        memset(Writer->Buffer + Writer->Len, Char, Count);
+    }
+    else if(Writer->Len < Writer->Cap)
+    {
+        memset(Writer->Buffer + Writer->Len, Char, Writer->Cap - Writer->Len);
+    }
+    Writer->Len += Count;
+}
+
+isa_global const char Isa__DigitPairs__[201] = "00010203040506070809"
+                                               "10111213141516171819"
+                                               "20212223242526272829"
+                                               "30313233343536373839"
+                                               "40414243444546474849"
+                                               "50515253545556575859"
+                                               "60616263646566676869"
+                                               "70717273747576777879"
+                                               "80818283848586878889"
+                                               "90919293949596979899";
+
+/**
+ * @brief Writes the decimal digits of Value so that they end right before End
+ * @return The number of digits, at most 20
+ */
+u32
+Isa__FormatDecimal__(char *End, u64 Value)
+{
+    char *At = End;
+    while(Value >= 100)
+    {
+        u64 Pair = (Value % 100) * 2;
+        Value /= 100;
+        At -= 2;
+        memcpy(At, Isa__DigitPairs__ + Pair, 2);
+    }
+
+    if(Value >= 10)
+    {
+        At -= 2;
+        memcpy(At, Isa__DigitPairs__ + (Value * 2), 2);
+    }
+    else
+    {
+        *--At = (char)('0' + Value);
+    }
+
+    return (u32)(End - At);
+}
+
+/**
+ * @param Shift 4 for hexadecimal, 3 for octal
+ */
+u32
+Isa__FormatPowerOfTwo__(char *End, u64 Value, u32 Shift, bool Upper)
+{
+    const char *Digits = Upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    u64         Mask   = ((u64)1 << Shift) - 1;
+
+    char *At = End;
+    do
+    {
+        *--At = Digits[Value & Mask];
+        Value >>= Shift;
+    } while(Value);
+
+    return (u32)(End - At);
+}
+
+void
+Isa__FormatPutUint__(isa__format_writer__ *Writer, u64 Value)
+{
+    char Digits[20];
+    u32  Count = Isa__FormatDecimal__(Digits + sizeof(Digits), Value);
+    Isa__FormatPut__(Writer, Digits + sizeof(Digits) - Count, Count);
+}
+
+void
+Isa__FormatPutInt__(isa__format_writer__ *Writer, i64 Value)
+{
+    if(Value < 0)
+    {
+        Isa__FormatPutChar__(Writer, '-');
+        Isa__FormatPutUint__(Writer, (u64)0 - (u64)Value);
+    }
+    else
+    {
+        Isa__FormatPutUint__(Writer, (u64)Value);
+    }
+}
+
+/* 64x64->128-bit multiplication, split in 32-bit halves so it works on every
+ * compiler */
+u64
+Isa__Mul64__(u64 A, u64 B, u64 *Hi)
+{
+    u64 ALo = A & 0xFFFFFFFFULL, AHi = A >> 32;
+    u64 BLo = B & 0xFFFFFFFFULL, BHi = B >> 32;
+
+    u64 LoLo = ALo * BLo;
+    u64 HiLo = AHi * BLo;
+    u64 LoHi = ALo * BHi;
+    u64 HiHi = AHi * BHi;
+
+    u64 Cross = (LoLo >> 32) + (HiLo & 0xFFFFFFFFULL) + LoHi;
+    *Hi       = HiHi + (HiLo >> 32) + (Cross >> 32);
+    return (Cross << 32) | (LoLo & 0xFFFFFFFFULL);
+}
+
+typedef struct isa__double_bits__
+{
+    bool Negative;
+    i32  Exponent;    /* Value is Significand * 2^Exponent */
+    u64  Significand; /* Includes the hidden bit for normal numbers */
+    u32  BiasedExponent;
+} isa__double_bits__;
+
+isa__double_bits__
+Isa__DoubleBits__(f64 Value)
+{
+    u64 Bits;
+    memcpy(&Bits, &Value, sizeof(Bits));
+
+    isa__double_bits__ Result;
+    Result.Negative       = (Bits >> 63) != 0;
+    Result.BiasedExponent = (u32)((Bits >> 52) & 0x7FF);
+    Result.Significand    = Bits & 0x000FFFFFFFFFFFFFULL;
+    if(Result.BiasedExponent)
+    {
+        Result.Significand |= 0x0010000000000000ULL;
+        Result.Exponent = (i32)Result.BiasedExponent - 1075;
+    }
+    else
+    {
+        Result.Exponent = -1074;
+    }
+
+    return Result;
+}
+
+isa_global const u64 Isa__Pow10U64__[20] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+/**
+ * @brief Computes |Value| * 10^Precision rounded half-to-even, exactly
+ * @return false if the result does not fit in 64 bits or Value is not finite
+ */
+bool
+Isa__FixedDigits__(f64 Value, u32 Precision, u64 *Result)
+{
+    isa__double_bits__ Bits = Isa__DoubleBits__(Value);
+    if(0x7FF == Bits.BiasedExponent || Precision > 17)
+    {
+        return false;
+    }
+
+    u64 Hi;
+    u64 Lo = Isa__Mul64__(Bits.Significand, Isa__Pow10U64__[Precision], &Hi);
+    if(Bits.Exponent >= 0)
+    {
+        if(Hi || Bits.Exponent >= 64 || (Bits.Exponent > 0 && (Lo >> (64 - Bits.Exponent))))
+        {
+            return false;
+        }
+
+        *Result = Lo << Bits.Exponent;
+        return true;
+    }
+
+    // NOTE(ingar): The product is below 2^111, so from there on everything
+    // is shifted out and rounds to 0
+    u32 Shift = (u32)-Bits.Exponent;
+    if(Shift >= 112)
+    {
+        *Result = 0;
+        return true;
+    }
+
+    u64 Quotient, RemHi, RemLo, HalfHi, HalfLo;
+    if(Shift >= 64)
+    {
+        Quotient = Hi >> (Shift - 64);
+        RemHi    = (Shift > 64) ? (Hi & (((u64)1 << (Shift - 64)) - 1)) : 0;
+        RemLo    = Lo;
+    }
+    else
+    {
+        if(Hi >> Shift)
+        {
+            return false;
+        }
+        Quotient = (Lo >> Shift) | (Hi << (64 - Shift));
+        RemHi    = 0;
+        RemLo    = Lo & (((u64)1 << Shift) - 1);
+    }
+
+    if(Shift > 64)
+    {
+        HalfHi = (u64)1 << (Shift - 65);
+        HalfLo = 0;
+    }
+    else
+    {
+        HalfHi = 0;
+        HalfLo = (u64)1 << (Shift - 1);
+    }
+
+    bool Above = (RemHi > HalfHi) || (RemHi == HalfHi && RemLo > HalfLo);
+    bool Tie   = (RemHi == HalfHi) && (RemLo == HalfLo);
+    if(Above || (Tie && (Quotient & 1)))
+    {
+        if(0 == ++Quotient)
+        {
+            return false;
+        }
+    }
+
+    *Result = Quotient;
+    return true;
+}
+
+/* Grisu2, after Florian Loitsch's "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers" and Milo Yip's implementation of it. The digits it
+ * produces always read back as the same double, and are the shortest such
+ * digits for all but a tiny fraction of values */
+
+typedef struct isa__diy_fp__
+{
+    u64 F;
+    i32 E;
+} isa__diy_fp__;
+
+/* Normalized 10^k for k = -348, -340, ..., 340 */
+isa_global const u64 Isa__CachedPowersF__[87] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL,
+    0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL,
+    0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL, 0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL, 0xdbac6c247d62a584ULL,
+    0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL,
+    0x8a08f0f8bf0f156bULL, 0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL, 0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL,
+    0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL,
+    0xc45d1df942711d9aULL, 0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL,
+    0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL,
+    0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL, 0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL, 0x9e19db92b4e31ba9ULL,
+    0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+isa_global const i16 Isa__CachedPowersE__[87] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847, -821, -794,
+    -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56, 83, 109, 136, 162, 189, 216, 242, 269, 295,
+    322, 348, 375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880, 907,
+    933, 960, 986, 1013, 1039, 1066
+};
+
+isa__diy_fp__
+Isa__DiyFpMul__(isa__diy_fp__ A, isa__diy_fp__ B)
+{
+    u64 Hi;
+    u64 Lo = Isa__Mul64__(A.F, B.F, &Hi);
+
+    isa__diy_fp__ Result;
+    Result.F = Hi + (Lo >> 63); /* Round */
+    Result.E = A.E + B.E + 64;
+    return Result;
+}
+
+isa__diy_fp__
+Isa__DiyFpNormalize__(isa__diy_fp__ Value)
+{
+    while(!(Value.F & 0x8000000000000000ULL))
+    {
+        Value.F <<= 1;
+        --Value.E;
+    }
+
+    return Value;
+}
+
+void
+Isa__GrisuRound__(char *Buffer, u32 Len, u64 Delta, u64 Rest, u64 TenKappa, u64 WpW)
+{
+    while(Rest < WpW && (Delta - Rest) >= TenKappa
+          && ((Rest + TenKappa) < WpW || (WpW - Rest) > (Rest + TenKappa - WpW)))
+    {
+        --Buffer[Len - 1];
+        Rest += TenKappa;
+    }
+}
+
+/**
+ * @brief Writes the digits of a positive, finite Value to Buffer (at least 18
+ * bytes)
+ * @return The number of digits; Value is Buffer * 10^*DecimalExponent
+ */
+u32
+Isa__Grisu2__(f64 Value, char *Buffer, i32 *DecimalExponent)
+{
+    isa__double_bits__ Bits = Isa__DoubleBits__(Value);
+    isa__diy_fp__      V    = { Bits.Significand, Bits.Exponent };
+
+    /* Boundaries halfway to the neighbouring doubles */
+    isa__diy_fp__ Plus = { (V.F << 1) + 1, V.E - 1 };
+    while(!(Plus.F & (0x0010000000000000ULL << 1)))
+    {
+        Plus.F <<= 1;
+        --Plus.E;
+    }
+    Plus.F <<= 10;
+    Plus.E -= 10;
+
+    isa__diy_fp__ Minus;
+    if(V.F == 0x0010000000000000ULL)
+    {
+        Minus.F = (V.F << 2) - 1;
+        Minus.E = V.E - 2;
+    }
+    else
+    {
+        Minus.F = (V.F << 1) - 1;
+        Minus.E = V.E - 1;
+    }
+    Minus.F <<= Minus.E - Plus.E;
+    Minus.E = Plus.E;
+
+    /* Scale by a cached power of ten so the exponent lands in [-60, -32] */
+    f64 Dk    = ((-61 - Plus.E) * 0.30102999566398114) + 347;
+    i32 K     = (i32)Dk;
+    K        += (Dk - K > 0.0) ? 1 : 0;
+    u32 Index = (u32)((K >> 3) + 1);
+
+    isa__diy_fp__ CachedPower = { Isa__CachedPowersF__[Index], Isa__CachedPowersE__[Index] };
+    *DecimalExponent          = -(-348 + (i32)(Index << 3));
+
+    isa__diy_fp__ W  = Isa__DiyFpMul__(Isa__DiyFpNormalize__(V), CachedPower);
+    isa__diy_fp__ Wp = Isa__DiyFpMul__(Plus, CachedPower);
+    isa__diy_fp__ Wm = Isa__DiyFpMul__(Minus, CachedPower);
+    ++Wm.F;
+    --Wp.F;
+
+    /* Generate digits until they are inside the rounding interval */
+    u64 Delta = Wp.F - Wm.F;
+    u64 WpW   = Wp.F - W.F;
+    u32 Shift = (u32)-Wp.E;
+    u64 One   = (u64)1 << Shift;
+    u32 P1    = (u32)(Wp.F >> Shift);
+    u64 P2    = Wp.F & (One - 1);
+
+    i32 Kappa = 1;
+    while(Kappa < 10 && P1 >= Isa__Pow10U64__[Kappa])
+    {
+        ++Kappa;
+    }
+
+    u32 Len = 0;
+    while(Kappa > 0)
+    {
+        u32 Pow   = (u32)Isa__Pow10U64__[Kappa - 1];
+        u32 Digit = P1 / Pow;
+        P1 %= Pow;
+        if(Digit || Len)
+        {
+            Buffer[Len++] = (char)('0' + Digit);
+        }
+        --Kappa;
+
+        u64 Rest = ((u64)P1 << Shift) + P2;
+        if(Rest <= Delta)
+        {
+            *DecimalExponent += Kappa;
+            Isa__GrisuRound__(Buffer, Len, Delta, Rest, Isa__Pow10U64__[Kappa] << Shift, WpW);
+            return Len;
+        }
+    }
+
+    for(;;)
+    {
+        P2 *= 10;
+        Delta *= 10;
+        char Digit = (char)(P2 >> Shift);
+        if(Digit || Len)
+        {
+            Buffer[Len++] = (char)('0' + Digit);
+        }
+        P2 &= One - 1;
+        --Kappa;
+
+        if(P2 < Delta)
+        {
+            *DecimalExponent += Kappa;
+            Isa__GrisuRound__(Buffer, Len, Delta, P2, One, WpW * ((-Kappa < 10) ? Isa__Pow10U64__[-Kappa] : 0));
+            return Len;
+        }
+    }
+}
+
+/**
+ * @brief Writes the shortest representation of Value that reads back the
+ * same, in plain notation for exponents -5 to 20 and scientific otherwise
+ * @return Number of characters written to Out (at most 32)
+ */
+u32
+Isa__FormatShortest__(char *Out, f64 Value)
+{
+    isa__double_bits__ Bits = Isa__DoubleBits__(Value);
+
+    u32 Len = 0;
+    if(Bits.Negative)
+    {
+        Out[Len++] = '-';
+    }
+
+    if(0x7FF == Bits.BiasedExponent)
+    {
+        memcpy(Out + Len, (Bits.Significand & 0x000FFFFFFFFFFFFFULL) ? "nan" : "inf", 3);
+        return Len + 3;
+    }
+
+    if(0 == Bits.Significand)
+    {
+        Out[Len++] = '0';
+        return Len;
+    }
+
+    char Digits[20];
+    i32  Exponent   = 0;
+    u32  DigitCount = Isa__Grisu2__(Bits.Negative ? -Value : Value, Digits, &Exponent);
+
+    /* Position of the decimal point relative to the first digit */
+    i32 Point = (i32)DigitCount + Exponent;
+    if(Exponent >= 0 && Point <= 21)
+    {
+        memcpy(Out + Len, Digits, DigitCount);
+        Len += DigitCount;
+        memset(Out + Len, '0', (u64)Exponent);
+        Len += (u32)Exponent;
+    }
+    else if(Point > 0 && Point <= 21)
+    {
+        memcpy(Out + Len, Digits, (u64)Point);
+        Len += (u32)Point;
+        Out[Len++] = '.';
+        memcpy(Out + Len, Digits + Point, DigitCount - (u32)Point);
+        Len += DigitCount - (u32)Point;
+    }
+    else if(Point > -5 && Point <= 0)
+    {
+        Out[Len++] = '0';
+        Out[Len++] = '.';
+        memset(Out + Len, '0', (u64)-Point);
+        Len += (u32)-Point;
+        memcpy(Out + Len, Digits, DigitCount);
+        Len += DigitCount;
+    }
+    else
+    {
+        Out[Len++] = Digits[0];
+        if(DigitCount > 1)
+        {
+            Out[Len++] = '.';
+            memcpy(Out + Len, Digits + 1, DigitCount - 1);
+            Len += DigitCount - 1;
+        }
+
+        i32 Exp10  = Point - 1;
+        Out[Len++] = 'e';
+        Out[Len++] = (Exp10 < 0) ? '-' : '+';
+        Exp10      = (Exp10 < 0) ? -Exp10 : Exp10;
+        if(Exp10 < 10)
+        {
+            Out[Len++] = '0';
+        }
+        Len += Isa__FormatDecimal__(Out + Len + ((Exp10 >= 100) ? 3 : (Exp10 >= 10) ? 2 : 1), (u64)Exp10);
+    }
+
+    return Len;
+}
+
+void
+Isa__FormatPutShortest__(isa__format_writer__ *Writer, f64 Value)
+{
+    char Out[32];
+    u32  Len = Isa__FormatShortest__(Out, Value);
+    Isa__FormatPut__(Writer, Out, Len);
+}
+
+enum
+{
+    ISA__FORMAT_LEFT__  = 1 << 0,
+    ISA__FORMAT_PLUS__  = 1 << 1,
+    ISA__FORMAT_SPACE__ = 1 << 2,
+    ISA__FORMAT_ZERO__  = 1 << 3,
+    ISA__FORMAT_ALT__   = 1 << 4,
+};
+
+enum
+{
+    ISA__FORMAT_LEN_NONE__,
+    ISA__FORMAT_LEN_HH__,
+    ISA__FORMAT_LEN_H__,
+    ISA__FORMAT_LEN_L__,
+    ISA__FORMAT_LEN_LL__,
+    ISA__FORMAT_LEN_Z__,
+    ISA__FORMAT_LEN_J__,
+    ISA__FORMAT_LEN_T__,
+    ISA__FORMAT_LEN_BIG_L__,
+};
+
+typedef struct isa__format_spec__
+{
+    u32 Flags;
+    i32 Width;
+    i32 Precision; /* -1 if not given */
+    u32 Length;
+} isa__format_spec__;
+
+/**
+ * @brief Writes Prefix, ZeroFill zeros and Body, padded to the spec's width
+ */
+void
+Isa__FormatPadded__(isa__format_writer__ *Writer, const isa__format_spec__ *Spec, const char *Prefix, u64 PrefixLen,
+                    u64 ZeroFill, const char *Body, u64 BodyLen)
+{
+    u64 Len = PrefixLen + ZeroFill + BodyLen;
+    u64 Pad = ((u64)Spec->Width > Len) ? (u64)Spec->Width - Len : 0;
+
+    if(Pad && !(Spec->Flags & (ISA__FORMAT_LEFT__ | ISA__FORMAT_ZERO__)))
+    {
+        Isa__FormatPutRepeated__(Writer, ' ', Pad);
+    }
+
+    Isa__FormatPut__(Writer, Prefix, PrefixLen);
+    if(Pad && (Spec->Flags & ISA__FORMAT_ZERO__) && !(Spec->Flags & ISA__FORMAT_LEFT__))
+    {
+        ZeroFill += Pad;
+    }
+    Isa__FormatPutRepeated__(Writer, '0', ZeroFill);
+    Isa__FormatPut__(Writer, Body, BodyLen);
+
+    if(Pad && (Spec->Flags & ISA__FORMAT_LEFT__))
+    {
+        Isa__FormatPutRepeated__(Writer, ' ', Pad);
+    }
+}
+
+void
+Isa__FormatInteger__(isa__format_writer__ *Writer, const isa__format_spec__ *Spec, u64 Magnitude, bool Negative,
+                     char Conversion)
+{
+    char  Digits[24];
+    char  Prefix[2];
+    u64   PrefixLen = 0;
+    char *End       = Digits + sizeof(Digits);
+
+    u32 DigitCount = 0;
+    switch(Conversion)
+    {
+        case 'x':
+        case 'X':
+        {
+            DigitCount = Isa__FormatPowerOfTwo__(End, Magnitude, 4, 'X' == Conversion);
+            if((Spec->Flags & ISA__FORMAT_ALT__) && Magnitude)
+            {
+                Prefix[0] = '0';
+                Prefix[1] = Conversion;
+                PrefixLen = 2;
+            }
+        }
+        break;
+        case 'o':
+        {
+            DigitCount = Isa__FormatPowerOfTwo__(End, Magnitude, 3, false);
+        }
+        break;
+        case 'u':
+        {
+            DigitCount = Isa__FormatDecimal__(End, Magnitude);
+        }
+        break;
+        default:
+        {
+            DigitCount = Isa__FormatDecimal__(End, Magnitude);
+            if(Negative)
+            {
+                Prefix[PrefixLen++] = '-';
+            }
+            else if(Spec->Flags & ISA__FORMAT_PLUS__)
+            {
+                Prefix[PrefixLen++] = '+';
+            }
+            else if(Spec->Flags & ISA__FORMAT_SPACE__)
+            {
+                Prefix[PrefixLen++] = ' ';
+            }
+        }
+        break;
+    }
+
+    isa__format_spec__ Padding  = *Spec;
+    u64                ZeroFill = 0;
+    if(Spec->Precision >= 0)
+    {
+        // NOTE(ingar): An explicit precision turns off zero padding, and a
+        // precision of 0 prints nothing at all for 0
+        Padding.Flags &= ~(u32)ISA__FORMAT_ZERO__;
+        if(0 == Spec->Precision && 0 == Magnitude)
+        {
+            DigitCount = 0;
+        }
+        ZeroFill = ((u64)Spec->Precision > DigitCount) ? (u64)Spec->Precision - DigitCount : 0;
+    }
+
+    if('o' == Conversion && (Spec->Flags & ISA__FORMAT_ALT__) && 0 == ZeroFill
+       && (0 == DigitCount || '0' != End[-(i32)DigitCount]))
+    {
+        ZeroFill = 1;
+    }
+
+    Isa__FormatPadded__(Writer, &Padding, Prefix, PrefixLen, ZeroFill, End - DigitCount, DigitCount);
+}
+
+void
+Isa__FormatString__(isa__format_writer__ *Writer, const isa__format_spec__ *Spec, const char *String, u64 Len)
+{
+    isa__format_spec__ Padding = *Spec;
+    Padding.Flags &= ~(u32)ISA__FORMAT_ZERO__;
+    Isa__FormatPadded__(Writer, &Padding, "", 0, 0, String, Len);
+}
+
+/**
+ * @brief printf's %f, computed exactly when Isa__FixedDigits__ can
+ * @return false if the caller must fall back to snprintf
+ */
+bool
+Isa__FormatFixed__(isa__format_writer__ *Writer, const isa__format_spec__ *Spec, f64 Value)
+{
+    u32 Precision = (Spec->Precision < 0) ? 6 : (u32)Spec->Precision;
+
+    u64 Scaled;
+    if(!Isa__FixedDigits__(Value, Precision, &Scaled))
+    {
+        return false;
+    }
+
+    char  Digits[48];
+    char *End   = Digits + sizeof(Digits);
+    char *Start = End;
+    if(Precision > 0)
+    {
+        u64 Fraction = Scaled % Isa__Pow10U64__[Precision];
+        for(u32 i = 0; i < Precision; ++i)
+        {
+            *--Start = (char)('0' + (Fraction % 10));
+            Fraction /= 10;
+        }
+    }
+    if(Precision > 0 || (Spec->Flags & ISA__FORMAT_ALT__))
+    {
+        *--Start = '.';
+    }
+    Start -= Isa__FormatDecimal__(Start, Scaled / Isa__Pow10U64__[Precision]);
+
+    char Prefix[1];
+    u64  PrefixLen = 0;
+    if(Isa__DoubleBits__(Value).Negative)
+    {
+        Prefix[PrefixLen++] = '-';
+    }
+    else if(Spec->Flags & ISA__FORMAT_PLUS__)
+    {
+        Prefix[PrefixLen++] = '+';
+    }
+    else if(Spec->Flags & ISA__FORMAT_SPACE__)
+    {
+        Prefix[PrefixLen++] = ' ';
+    }
+
+    Isa__FormatPadded__(Writer, Spec, Prefix, PrefixLen, 0, Start, (u64)(End - Start));
+    return true;
+}
+
+/**
+ * @brief Hands a conversion the engine does not do itself to snprintf
+ */
+void
+Isa__FormatWithLibc__(isa__format_writer__ *Writer, const isa__format_spec__ *Spec, char Conversion, f64 Value,
+                      long double LongValue)
+{
+    char Format[32];
+    u32  Len      = 0;
+    Format[Len++] = '%';
+    if(Spec->Flags & ISA__FORMAT_LEFT__)
+    {
+        Format[Len++] = '-';
+    }
+    if(Spec->Flags & ISA__FORMAT_PLUS__)
+    {
+        Format[Len++] = '+';
+    }
+    if(Spec->Flags & ISA__FORMAT_SPACE__)
+    {
+        Format[Len++] = ' ';
+    }
+    if(Spec->Flags & ISA__FORMAT_ZERO__)
+    {
+        Format[Len++] = '0';
+    }
+    if(Spec->Flags & ISA__FORMAT_ALT__)
+    {
+        Format[Len++] = '#';
+    }
+    Format[Len++] = '*';
+    Format[Len++] = '.';
+    Format[Len++] = '*';
+    if(ISA__FORMAT_LEN_BIG_L__ == Spec->Length)
+    {
+        Format[Len++] = 'L';
+    }
+    Format[Len++] = Conversion;
+    Format[Len]   = '\0';
+
+    char Temp[512];
+    i32  Written;
+    if(ISA__FORMAT_LEN_BIG_L__ == Spec->Length)
+    {
+        Written = snprintf(Temp, sizeof(Temp), Format, Spec->Width, Spec->Precision, LongValue);
+    }
+    else
+    {
+        Written = snprintf(Temp, sizeof(Temp), Format, Spec->Width, Spec->Precision, Value);
+    }
+
+    if(Written < 0)
+    {
+        return;
+    }
+
+    if((u64)Written < sizeof(Temp))
+    {
+        Isa__FormatPut__(Writer, Temp, (u64)Written);
+        return;
+    }
+
+    // NOTE(ingar): Only huge values with %f or a large width or precision
+    // get here; those are written in place if they fit. Otherwise they go
+    // through the heap, so a full writer still gets the part that fits
+    bool  Fits = ((Writer->Len + (u64)Written) < Writer->Cap) || Isa__FormatGrow__(Writer, (u64)Written + 1);
+    char *Out  = Fits ? (Writer->Buffer + Writer->Len) : (char *)malloc((u64)Written + 1);
+    if(!Out)
+    {
+        Isa__FormatPut__(Writer, Temp, sizeof(Temp) - 1);
+        Writer->Len += (u64)Written - (sizeof(Temp) - 1);
+        return;
+    }
+
+    if(ISA__FORMAT_LEN_BIG_L__ == Spec->Length)
+    {
+        snprintf(Out, (u64)Written + 1, Format, Spec->Width, Spec->Precision, LongValue);
+    }
+    else
+    {
+        snprintf(Out, (u64)Written + 1, Format, Spec->Width, Spec->Precision, Value);
+    }
+
+    if(Fits)
+    {
+        Writer->Len += (u64)Written;
+    }
+    else
+    {
+        Isa__FormatPut__(Writer, Out, (u64)Written);
+        free(Out);
+    }
+}
+
+/**
+ * @brief Appends Format to Writer, consuming arguments from VaArgs
+ */
+void
+Isa__FormatWriteV__(isa__format_writer__ *Writer, const char *Format, va_list VaArgs)
+{
+    const char *At = Format;
+    for(;;)
+    {
+        const char *Literal = At;
+        while(*At && '%' != *At)
+        {
+            ++At;
+        }
+        Isa__FormatPut__(Writer, Literal, (u64)(At - Literal));
+        if(!*At)
+        {
+            break;
+        }
+
+        const char        *SpecStart = At++;
+        isa__format_spec__ Spec      = { 0, 0, -1, ISA__FORMAT_LEN_NONE__ };
+        for(;; ++At)
+        {
+            u32 Flag = ('-' == *At)   ? ISA__FORMAT_LEFT__
+                       : ('+' == *At) ? ISA__FORMAT_PLUS__
+                       : (' ' == *At) ? ISA__FORMAT_SPACE__
+                       : ('0' == *At) ? ISA__FORMAT_ZERO__
+                       : ('#' == *At) ? ISA__FORMAT_ALT__
+                                      : 0;
+            if(!Flag)
+            {
+                break;
+            }
+            Spec.Flags |= Flag;
+        }
+
+        if('*' == *At)
+        {
+            Spec.Width = va_arg(VaArgs, int);
+            if(Spec.Width < 0)
+            {
+                Spec.Flags |= ISA__FORMAT_LEFT__;
+                Spec.Width = -Spec.Width;
+            }
+            ++At;
+        }
+        else
+        {
+            while(*At >= '0' && *At <= '9')
+            {
+                Spec.Width = (Spec.Width * 10) + (*At++ - '0');
+            }
+        }
+
+        if('.' == *At)
+        {
+            ++At;
+            Spec.Precision = 0;
+            if('*' == *At)
+            {
+                Spec.Precision = va_arg(VaArgs, int);
+                Spec.Precision = (Spec.Precision < 0) ? -1 : Spec.Precision;
+                ++At;
+            }
+            else
+            {
+                while(*At >= '0' && *At <= '9')
+                {
+                    Spec.Precision = (Spec.Precision * 10) + (*At++ - '0');
+                }
+            }
+        }
+
+        switch(*At)
+        {
+            case 'h':
+            {
+                Spec.Length = ('h' == At[1]) ? ISA__FORMAT_LEN_HH__ : ISA__FORMAT_LEN_H__;
+                At += ('h' == At[1]) ? 2 : 1;
+            }
+            break;
+            case 'l':
+            {
+                Spec.Length = ('l' == At[1]) ? ISA__FORMAT_LEN_LL__ : ISA__FORMAT_LEN_L__;
+                At += ('l' == At[1]) ? 2 : 1;
+            }
+            break;
+            case 'z':
+            {
+                Spec.Length = ISA__FORMAT_LEN_Z__;
+                ++At;
+            }
+            break;
+            case 'j':
+            {
+                Spec.Length = ISA__FORMAT_LEN_J__;
+                ++At;
+            }
+            break;
+            case 't':
+            {
+                Spec.Length = ISA__FORMAT_LEN_T__;
+                ++At;
+            }
+            break;
+            case 'L':
+            {
+                Spec.Length = ISA__FORMAT_LEN_BIG_L__;
+                ++At;
+            }
+            break;
+        }
+
+        char Conversion = *At;
+        if(Conversion)
+        {
+            ++At;
+        }
+
+        switch(Conversion)
+        {
+            case 'd':
+            case 'i':
+            {
+                i64 Value;
+                switch(Spec.Length)
+                {
+                    case ISA__FORMAT_LEN_HH__:
+                    {
+                        Value = (signed char)va_arg(VaArgs, int);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_H__:
+                    {
+                        Value = (short)va_arg(VaArgs, int);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_L__:
+                    {
+                        Value = va_arg(VaArgs, long);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_LL__:
+                    {
+                        Value = va_arg(VaArgs, long long);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_Z__:
+                    case ISA__FORMAT_LEN_T__:
+                    {
+                        Value = va_arg(VaArgs, ptrdiff_t);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_J__:
+                    {
+                        Value = va_arg(VaArgs, intmax_t);
+                    }
+                    break;
+                    default:
+                    {
+                        Value = va_arg(VaArgs, int);
+                    }
+                    break;
+                }
+
+                u64 Magnitude = (Value < 0) ? (u64)0 - (u64)Value : (u64)Value;
+                Isa__FormatInteger__(Writer, &Spec, Magnitude, Value < 0, 'd');
+            }
+            break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            {
+                u64 Value;
+                switch(Spec.Length)
+                {
+                    case ISA__FORMAT_LEN_HH__:
+                    {
+                        Value = (unsigned char)va_arg(VaArgs, unsigned int);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_H__:
+                    {
+                        Value = (unsigned short)va_arg(VaArgs, unsigned int);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_L__:
+                    {
+                        Value = va_arg(VaArgs, unsigned long);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_LL__:
+                    {
+                        Value = va_arg(VaArgs, unsigned long long);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_Z__:
+                    case ISA__FORMAT_LEN_T__:
+                    {
+                        Value = va_arg(VaArgs, size_t);
+                    }
+                    break;
+                    case ISA__FORMAT_LEN_J__:
+                    {
+                        Value = va_arg(VaArgs, uintmax_t);
+                    }
+                    break;
+                    default:
+                    {
+                        Value = va_arg(VaArgs, unsigned int);
+                    }
+                    break;
+                }
+
+                Isa__FormatInteger__(Writer, &Spec, Value, false, Conversion);
+            }
+            break;
+            case 'c':
+            {
+                char Char = (char)va_arg(VaArgs, int);
+                Isa__FormatString__(Writer, &Spec, &Char, 1);
+            }
+            break;
+            case 's':
+            {
+                const char *String = va_arg(VaArgs, const char *);
+                String             = String ? String : "(null)";
+
+                u64 Len = 0;
+                if(Spec.Precision >= 0)
+                {
+                    while(Len < (u64)Spec.Precision && String[Len])
+                    {
+                        ++Len;
+                    }
+                }
+                else
+                {
+                    Len = strlen(String);
+                }
+
+                Isa__FormatString__(Writer, &Spec, String, Len);
+            }
+            break;
+            case 'S':
+            {
+                isa_string String = va_arg(VaArgs, isa_string);
+                u64        Len    = String.S ? String.Len : 0;
+                if(Spec.Precision >= 0)
+                {
+                    Len = IsaMin(Len, (u64)Spec.Precision);
+                }
+
+                Isa__FormatString__(Writer, &Spec, String.S, Len);
+            }
+            break;
+            case 'p':
+            {
+                void *Pointer = va_arg(VaArgs, void *);
+                if(!Pointer)
+                {
+                    Isa__FormatString__(Writer, &Spec, "(nil)", 5);
+                }
+                else
+                {
+                    isa__format_spec__ Hex = Spec;
+                    Hex.Flags |= ISA__FORMAT_ALT__;
+                    Isa__FormatInteger__(Writer, &Hex, (u64)(uintptr_t)Pointer, false, 'x');
+                }
+            }
+            break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+            {
+                if(ISA__FORMAT_LEN_BIG_L__ == Spec.Length)
+                {
+                    long double Value = va_arg(VaArgs, long double);
+                    Isa__FormatWithLibc__(Writer, &Spec, Conversion, 0.0, Value);
+                }
+                else
+                {
+                    f64 Value = va_arg(VaArgs, double);
+                    if(('f' != Conversion && 'F' != Conversion) || !Isa__FormatFixed__(Writer, &Spec, Value))
+                    {
+                        Isa__FormatWithLibc__(Writer, &Spec, Conversion, Value, 0.0L);
+                    }
+                }
+            }
+            break;
+            case 'r':
+            {
+                char Digits[32];
+                u32  Len      = Isa__FormatShortest__(Digits, va_arg(VaArgs, double));
+                u32  Negative = ('-' == Digits[0]) ? 1 : 0;
+                char Sign     = Negative ? '-' : (Spec.Flags & ISA__FORMAT_PLUS__) ? '+' : ' ';
+                u64  SignLen  = (Negative || (Spec.Flags & (ISA__FORMAT_PLUS__ | ISA__FORMAT_SPACE__))) ? 1 : 0;
+
+                /* No zero padding for nan and inf */
+                isa__format_spec__ Padding = Spec;
+                if(Digits[Negative] > '9')
+                {
+                    Padding.Flags &= ~(u32)ISA__FORMAT_ZERO__;
+                }
+
+                Isa__FormatPadded__(Writer, &Padding, &Sign, SignLen, 0, Digits + Negative, Len - Negative);
+            }
+            break;
+            case '%':
+            {
+                Isa__FormatPutChar__(Writer, '%');
+            }
+            break;
+            case 'n':
+            {
+                (void)va_arg(VaArgs, void *);
+            }
+            break;
+            default:
+            {
+                /* Unknown conversions are written as they are */
+                Isa__FormatPut__(Writer, SpecStart, (u64)(At - SpecStart));
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief vsnprintf, using the conversions described at the top of FORMAT
+ * @return Length of the full output, excluding the null-terminator. The output
+ * was truncated if this is BufferSize or more
+ */
+i64
+IsaFormatV(char *Buffer, u64 BufferSize, const char *Format, va_list VaArgs)
+{
+    isa__format_writer__ Writer = { Buffer, BufferSize ? BufferSize - 1 : 0, 0, NULL };
+    Isa__FormatWriteV__(&Writer, Format, VaArgs);
+
+    if(BufferSize)
+    {
+        Buffer[IsaMin(Writer.Len, BufferSize - 1)] = '\0';
+    }
+
+    return (i64)Writer.Len;
+}
+
+i64
+IsaFormat(char *Buffer, u64 BufferSize, const char *Format, ...)
+{
+    va_list VaArgs;
+    va_start(VaArgs, Format);
+    i64 Len = IsaFormatV(Buffer, BufferSize, Format, VaArgs);
+    va_end(VaArgs);
+    return Len;
+}
+
+////////////////////////////////////////
+//              LOGGING               //
+////////////////////////////////////////
+/* Based on the logging frontend I wrote for oec */
+
+#if !defined(ISA_LOG_BUF_SIZE)
+#define ISA_LOG_BUF_SIZE 128
+#endif
+
+/* Backs each thread's format buffer. It is never made smaller than the buffer
+ * and the arena header together, so raising ISA_LOG_BUF_SIZE alone is enough */
+#if !defined(ISA_LOG_THREAD_ARENA_SIZE)
+#define ISA_LOG_THREAD_ARENA_SIZE (sizeof(isa_arena) + ISA_LOG_BUF_SIZE)
+#endif
+
+#if !defined(ISA_LOG_SPILL_MAX_SIZE)
+#define ISA_LOG_SPILL_MAX_SIZE IsaKibiByte(64) /* Longest line that is not truncated */
+#endif
+
+typedef struct isa__log_module__
+{
+    const char               *Name;
+    volatile u32              Level; /* Runtime level, see IsaLogSetLevels */
+    struct isa__log_module__ *Next;
+} isa__log_module__;
+
+// NOTE(ingar): The memory and file sections come after logging, so what
+// logging needs from them is declared here
+typedef struct isa__arena_block__ isa__arena_block__;
+typedef struct isa_arena_stats    isa_arena_stats;
+
+typedef struct isa_arena
+{
+    u64                 Cur;
+    u64                 Cap;
+    u64                 Save;      /* Makes it easier to use the arena as a stack */
+    u64                 Committed; /* How much of Mem is usable. Less than Cap only for reserved arenas */
+    u32                 Flags;
+    u32                 TempDepth; /* Open temp scopes, only counted in debug builds */
+    u64                 BasePos;   /* Chained arenas: the position Mem starts at */
+    isa__arena_block__ *Block;     /* Chained arenas: the block Mem is in */
+#if defined(ISA_ARENA_INSTRUMENT)
+    isa_arena_stats    *Stats;     /* NULL until the arena is registered */
+#endif
+    u8                 *Mem;       /* If it's last, the arena's memory can be contiguous with the struct
+                                      itself */
+} isa_arena;
+
+#if defined(ISA_ARENA_INSTRUMENT)
+void IsaArenaUnregister(isa_arena *Arena);
+void Isa__ArenaRecordSeek__(isa_arena *Arena, u64 Pos);
+void Isa__ArenaSnapshot__(isa_arena_stats *Stats, isa_arena *Arena);
+#endif
+
+typedef struct isa_file_data
+{
+    u64     Size;
+    uint8_t Data[];
+} isa_file_data;
+
+isa_arena     *IsaArenaCreateContiguous(void *Mem, u64 Size);
+void          *IsaArenaPush(isa_arena *Arena, u64 Size);
+isa_file_data *IsaLoadFileIntoMemory(const char *Filename);
+
+/* Each thread formats into its own buffer, so modules can be logged to from
+ * any number of threads without locking */
+typedef struct isa__log_thread__
+{
+    isa_arena *Arena;
+    char      *Buffer; /* ISA_LOG_BUF_SIZE bytes */
+    isa_arena *Spill;  /* Lines that do not fit in Buffer, grows as needed */
+    char      *SpillBuffer;
+    u64        SpillSize;
+} isa__log_thread__;
+
+// NOTE(ingar): The arenas are never freed, since there is no portable way to
+// run code on thread exit. A thread that has logged costs
+// ISA_LOG_THREAD_ARENA_SIZE, plus the size of its longest line if that did not
+// fit in ISA_LOG_BUF_SIZE
+isa__log_thread__ *
+Isa__GetLogThread__(void)
+{
+    isa_persist isa_thread_local isa__log_thread__ Thread = { 0 };
+    if(!Thread.Arena)
+    {
+        u64   ArenaSize = IsaMax((u64)ISA_LOG_THREAD_ARENA_SIZE, (u64)(sizeof(isa_arena) + ISA_LOG_BUF_SIZE));
+        void *Mem       = malloc(ArenaSize);
+        if(!Mem)
+        {
+            return NULL;
+        }
+
+        Thread.Arena  = IsaArenaCreateContiguous(Mem, ArenaSize);
+        Thread.Buffer = (char *)IsaArenaPush(Thread.Arena, ISA_LOG_BUF_SIZE);
+    }
+
+    return Thread.Buffer ? &Thread : NULL;
+}
+
+/**
+ * @brief Makes sure the thread's spill buffer holds at least Size bytes,
+ * keeping the KeepLen bytes at Keep, which may be the old spill buffer.
+ * It only ever grows, so once a thread has logged its longest line, long lines
+ * no longer allocate
+ * @return The buffer, which is smaller than Size if Size is more than
+ * ISA_LOG_SPILL_MAX_SIZE, or NULL
+ */
+char *
+Isa__GetLogSpillBuffer__(isa__log_thread__ *Thread, u64 Size, const char *Keep, u64 KeepLen)
+{
+    u64 SpillSize = IsaMax(Thread->SpillSize, (u64)ISA_LOG_BUF_SIZE);
+    while(SpillSize < Size)
+    {
+        SpillSize *= 2;
+    }
+    SpillSize = IsaMin(SpillSize, (u64)ISA_LOG_SPILL_MAX_SIZE);
+
+    if(SpillSize <= Thread->SpillSize)
+    {
+        if(Keep != Thread->SpillBuffer)
+        {
+            memcpy(Thread->SpillBuffer, Keep, IsaMin(KeepLen, Thread->SpillSize));
+        }
+        return Thread->SpillBuffer;
+    }
+
+    void *Mem = malloc(sizeof(isa_arena) + SpillSize);
+    if(!Mem)
+    {
+        return NULL;
+    }
+
+    isa_arena *Spill = IsaArenaCreateContiguous(Mem, sizeof(isa_arena) + SpillSize);
+    memcpy(Spill->Mem, Keep, IsaMin(KeepLen, SpillSize));
+    free(Thread->Spill);
+
+    Thread->Spill       = Spill;
+    Thread->SpillBuffer = (char *)Spill->Mem;
+    Thread->SpillSize   = SpillSize;
+
+    return Thread->SpillBuffer;
+}
+
+/**
+ * @brief Grow function for writers that start out in a line buffer. The line
+ * moves to the calling thread's spill buffer, so it must not outlive the next
+ * line the thread logs
+ */
+bool
+Isa__LogGrowLine__(isa__format_writer__ *Writer, u64 Size)
+{
+    isa__log_thread__ *Thread = Isa__GetLogThread__();
+    if(!Thread)
+    {
+        return false;
+    }
+
+    // NOTE(ingar): Cap holds one byte back for the null-terminator
+    char *Spill = Isa__GetLogSpillBuffer__(Thread, Size + 1, Writer->Buffer, Writer->Len);
+    if(!Spill)
+    {
+        return false;
+    }
+
+    Writer->Buffer = Spill;
+    Writer->Cap    = Thread->SpillSize - 1;
+    return Writer->Cap >= Size;
+}
+
+/* The date/time part of the prefix only changes once a second, so each thread
+ * keeps the last one it rendered and only appends the microseconds. This keeps
+ * localtime (and the timezone lock it takes) off the per-line path */
+typedef struct isa__log_time_cache__
+{
+    i64  Second; /* The second Prefix was rendered for */
+    u64  Len;
+    char Prefix[32];
+} isa__log_time_cache__;
+
+/**
+ * @brief Writes "<prefix>.<microseconds>: "
+ */
+u64
+Isa__FormatTimeFromCache__(char *__restrict Buffer, u64 BufferRemaining, isa__log_time_cache__ *Cache,
+                           u32 Microseconds)
+{
+    u64 CharsWritten = Cache->Len + 9;
+    if(CharsWritten >= BufferRemaining)
+    {
+        return -1;
+    }
+
+    memcpy(Buffer, Cache->Prefix, Cache->Len);
+
+    char *Cursor = Buffer + Cache->Len;
+    Cursor[0]    = '.';
+    for(int i = 6; i > 0; --i)
+    {
+        Cursor[i] = (char)('0' + (Microseconds % 10));
+        Microseconds /= 10;
+    }
+    Cursor[7] = ':';
+    Cursor[8] = ' ';
+
+    Buffer[CharsWritten] = '\0';
+    return CharsWritten;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// #define ISA_LOG_OUTPUTDEBUGSTRING
+
+#if defined(ISA_LOG_OUTPUTDEBUGSTRING)
+// TODO(ingar): OutputDebugString does not support formatting, so I need to find
+// some way to do that
+#define Isa__LogPrint__(string) OutputDebugStringA(string)
+#else
+#define Isa__LogPrint__(string) printf("%s", string)
+#endif
+
+/* One WriteFile per line, so lines from different threads never interleave */
+void
+Isa__LogWrite__(const char *Data, u64 Len)
+{
+#if defined(ISA_LOG_OUTPUTDEBUGSTRING)
+    (void)Len;
+    OutputDebugStringA(Data);
+#else
+    DWORD Written;
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), Data, (DWORD)Len, &Written, NULL);
+#endif
+}
+
+u64
+Isa__FormatTimeWin32__(char *__restrict Buffer, u64 BufferRemaining)
+{
+    isa_persist isa_thread_local isa__log_time_cache__ Cache = { -1, 0, { 0 } };
+
+    FILETIME Now;
+    GetSystemTimePreciseAsFileTime(&Now);
+
+    u64 Ticks  = ((u64)Now.dwHighDateTime << 32) | Now.dwLowDateTime; /* 100ns ticks since 1601 */
+    i64 Second = (i64)(Ticks / 10000000);
+    if(Second != Cache.Second)
+    {
+        SYSTEMTIME UtcTime, Time;
+        FileTimeToSystemTime(&Now, &UtcTime);
+        SystemTimeToTzSpecificLocalTime(NULL, &UtcTime, &Time);
+
+        int CharsWritten = snprintf(Cache.Prefix, sizeof(Cache.Prefix), "%04d-%02d-%02d %02d:%02d:%02d", Time.wYear,
+                                    Time.wMonth, Time.wDay, Time.wHour, Time.wMinute, Time.wSecond);
+        if(CharsWritten < 0)
+        {
+            return -1;
+        }
+
+        Cache.Len    = (u64)CharsWritten;
+        Cache.Second = Second;
+    }
+
+    return Isa__FormatTimeFromCache__(Buffer, BufferRemaining, &Cache, (u32)((Ticks / 10) % 1000000));
+}
+#define FormatTime Isa__FormatTimeWin32__
+
+#elif defined(__linux__)
+
+#define Isa__LogPrint__(string) printf("%s", string)
+
+/* One write per line, so lines from different threads never interleave. This
+ * bypasses stdio, so it isn't ordered with respect to buffered printf output */
+void
+Isa__LogWrite__(const char *Data, u64 Len)
+{
+    while(Len > 0)
+    {
+        ssize_t Written = write(STDOUT_FILENO, Data, Len);
+        if(Written < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if(Written <= 0)
+        {
+            break;
+        }
+
+        Data += Written;
+        Len -= (u64)Written;
+    }
+}
+
+u64
+Isa__FormatTimePosix__(char *__restrict Buffer, u64 BufferRemaining)
+{
+    isa_persist isa_thread_local isa__log_time_cache__ Cache = { -1, 0, { 0 } };
+
+    // NOTE(ingar): clock_gettime goes through the vDSO, so this is cheap.
+    // Seconds and microseconds come from the same reading so they always agree
+    struct timespec Now;
+    clock_gettime(CLOCK_REALTIME, &Now);
+    if((i64)Now.tv_sec != Cache.Second)
+    {
+        time_t    PosixTime = Now.tv_sec;
+        struct tm TimeInfo;
+        localtime_r(&PosixTime, &TimeInfo);
+
+        Cache.Len = strftime(Cache.Prefix, sizeof(Cache.Prefix), "%T", &TimeInfo);
+        if(0 == Cache.Len)
+        {
+            return -1;
+        }
+
+        Cache.Second = (i64)Now.tv_sec;
+    }
+
+    return Isa__FormatTimeFromCache__(Buffer, BufferRemaining, &Cache, (u32)(Now.tv_nsec / 1000));
+}
+#define FormatTime              Isa__FormatTimePosix__
+#elif defined(__APPLE__) && defined(__MACH__)
+#endif // Platform
+
+/**
+ * @brief Formats a line into Writer, which the caller sets up empty and with
+ * one byte held back for the null-terminator
+ * @return Length of the full line, excluding the null-terminator, or -1. A
+ * return value above Writer->Cap means the line was truncated, which only
+ * happens if Writer can not grow
+ * @note The line is always newline-terminated, even when truncated
+ */
+i64
+Isa__FormatLog__(isa__format_writer__ *Writer, const char *ModuleName, const char *LogLevel, va_list VaArgs)
+{
+    u64 CharsWritten = FormatTime(Writer->Buffer, Writer->Cap + 1);
+    if(CharsWritten > Writer->Cap)
+    {
+        return -1;
+    }
+
+    Writer->Len = CharsWritten;
+    Isa__FormatPut__(Writer, ModuleName, strlen(ModuleName));
+    Isa__FormatPut__(Writer, ": ", 2);
+    Isa__FormatPut__(Writer, LogLevel, strlen(LogLevel));
+    Isa__FormatPut__(Writer, ": ", 2);
+
+    const char *FormatString = va_arg(VaArgs, const char *);
+    Isa__FormatWriteV__(Writer, FormatString, VaArgs);
+    Isa__FormatPutChar__(Writer, '\n');
+
+    if(Writer->Len <= Writer->Cap)
+    {
+        Writer->Buffer[Writer->Len] = '\0';
+    }
+    else
+    {
+        Writer->Buffer[Writer->Cap - 1] = '\n';
+        Writer->Buffer[Writer->Cap]     = '\0';
+    }
+
+    return (i64)Writer->Len;
+}
+
+/* Sinks receive finished lines, or batches of whole lines from the async
+ * flusher. With no sinks added, lines go to stdout like before. Sinks should be
+ * added before other threads start logging and removed after they stop */
+
+#if !defined(ISA_LOG_MAX_SINKS)
+#define ISA_LOG_MAX_SINKS 8
+#endif
+
+typedef struct isa_log_sink isa_log_sink;
+
+typedef void isa_log_sink_write_fn(isa_log_sink *Sink, const char *Data, u64 Len);
+typedef void isa_log_sink_fn(isa_log_sink *Sink);
+
+struct isa_log_sink
+{
+    isa_log_sink_write_fn *Write;
+    isa_log_sink_fn       *Flush; /* Write out anything buffered */
+    isa_log_sink_fn       *Poll;  /* Optional, flush if the sink's own latency limit has passed */
+    isa_log_sink_fn       *Close; /* Flush and free */
+};
+
+typedef struct isa__log_sink_state__
+{
+    isa_mutex     Lock;
+    volatile u32  Count;
+    isa_log_sink *Sinks[ISA_LOG_MAX_SINKS];
+} isa__log_sink_state__;
+
+isa__log_sink_state__ *
+Isa__GetLogSinkState__(void)
+{
+    isa_persist isa__log_sink_state__ State = { ISA_MUTEX_INIT, 0, { NULL } };
+    return &State;
+}
+
+void
+Isa__LogOutput__(const char *Data, u64 Len)
+{
+    isa__log_sink_state__ *State = Isa__GetLogSinkState__();
+
+    u32 Count = IsaAtomicLoad32(&State->Count);
+    if(0 == Count)
+    {
+        Isa__LogWrite__(Data, Len);
+        return;
+    }
+
+    for(u32 i = 0; i < Count; ++i)
+    {
+        State->Sinks[i]->Write(State->Sinks[i], Data, Len);
+    }
+}
+
+bool
+IsaLogAddSink(isa_log_sink *Sink)
+{
+    isa__log_sink_state__ *State = Isa__GetLogSinkState__();
+    IsaMutexLock(&State->Lock);
+
+    bool Added = State->Count < ISA_LOG_MAX_SINKS;
+    if(Added)
+    {
+        State->Sinks[State->Count] = Sink;
+        IsaAtomicStore32(&State->Count, State->Count + 1);
+    }
+
+    IsaMutexUnlock(&State->Lock);
+    return Added;
+}
+
+/**
+ * @note Does not close the sink
+ */
+void
+IsaLogRemoveSink(isa_log_sink *Sink)
+{
+    isa__log_sink_state__ *State = Isa__GetLogSinkState__();
+    IsaMutexLock(&State->Lock);
+
+    for(u32 i = 0; i < State->Count; ++i)
+    {
+        if(State->Sinks[i] == Sink)
+        {
+            for(u32 j = i + 1; j < State->Count; ++j)
+            {
+                State->Sinks[j - 1] = State->Sinks[j];
+            }
+            IsaAtomicStore32(&State->Count, State->Count - 1);
+            break;
+        }
+    }
+
+    IsaMutexUnlock(&State->Lock);
+}
+
+void
+IsaLogFlushSinks(void)
+{
+    isa__log_sink_state__ *State = Isa__GetLogSinkState__();
+
+    u32 Count = IsaAtomicLoad32(&State->Count);
+    for(u32 i = 0; i < Count; ++i)
+    {
+        State->Sinks[i]->Flush(State->Sinks[i]);
+    }
+}
+
+void
+Isa__LogPollSinks__(void)
+{
+    isa__log_sink_state__ *State = Isa__GetLogSinkState__();
+
+    u32 Count = IsaAtomicLoad32(&State->Count);
+    for(u32 i = 0; i < Count; ++i)
+    {
+        if(State->Sinks[i]->Poll)
+        {
+            State->Sinks[i]->Poll(State->Sinks[i]);
+        }
+    }
+}
+
+void
+IsaLogSinkClose(isa_log_sink *Sink)
+{
+    Sink->Close(Sink);
+}
+
+void
+Isa__LogConsoleSinkWrite__(isa_log_sink *Sink, const char *Data, u64 Len)
+{
+    (void)Sink;
+    Isa__LogWrite__(Data, Len);
+}
+
+void
+Isa__LogConsoleSinkNop__(isa_log_sink *Sink)
+{
+    (void)Sink;
+}
+
+/**
+ * @brief The stdout output used when there are no sinks, for fanning out to
+ * the console and something else
+ */
+isa_log_sink *
+IsaLogConsoleSink(void)
+{
+    isa_persist isa_log_sink Sink
+        = { Isa__LogConsoleSinkWrite__, Isa__LogConsoleSinkNop__, NULL, Isa__LogConsoleSinkNop__ };
+    return &Sink;
+}
+
+u64
+Isa__LogNowUs__(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return GetTickCount64() * 1000;
+#else
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return ((u64)Now.tv_sec * 1000000ULL) + ((u64)Now.tv_nsec / 1000);
+#endif
+}
+
+/* The file sink appends lines to one of two buffers. A flush swaps them under
+ * a short lock and writes the full one under a separate I/O lock, so other
+ * threads keep appending while the write (and any rotation) is in progress.
+ * Flushes triggered by a write are skipped if another thread is already
+ * flushing. In async mode only the flusher thread ever writes, and it also
+ * polls the sink when idle. Without it, a quiet program's last lines stay
+ * buffered until the next write, IsaLogFlushSinks or IsaLogSinkClose */
+
+#if !defined(ISA_LOG_FILE_SINK_BUFFER_SIZE)
+#define ISA_LOG_FILE_SINK_BUFFER_SIZE IsaKibiByte(256) /* Each of the two buffers */
+#endif
+
+#if !defined(ISA_LOG_FILE_SINK_LATENCY_US)
+#define ISA_LOG_FILE_SINK_LATENCY_US 100000 /* Longest a line may sit in the buffer, checked on write and poll */
+#endif
+
+#define ISA__LOG_FILE_SINK_PATH_MAX__ 512
+
+typedef struct isa__log_file_sink__
+{
+    isa_log_sink Sink;
+    isa_mutex    Lock;   /* Guards Active */
+    isa_mutex    IoLock; /* Guards the file and Spare */
+    char        *Active;
+    u64          ActiveUsed;
+    u64          ActiveSince; /* When the oldest line in Active was buffered */
+    char        *Spare;
+    u64          FileSize;
+    u64          FileOpenedAt;
+    u64          RotateSize;
+    u64          RotateIntervalUs;
+    u32          MaxFiles;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE File;
+#else
+    int File;
+#endif
+    char Path[ISA__LOG_FILE_SINK_PATH_MAX__];
+} isa__log_file_sink__;
+
+bool
+Isa__LogFileSinkOpen__(isa__log_file_sink__ *FileSink)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    FileSink->File = CreateFileA(FileSink->Path, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                                 OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(INVALID_HANDLE_VALUE == FileSink->File)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER FileSize;
+    GetFileSizeEx(FileSink->File, &FileSize);
+    FileSink->FileSize = (u64)FileSize.QuadPart;
+#else
+    FileSink->File = open(FileSink->Path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(FileSink->File < 0)
+    {
+        return false;
+    }
+
+    FileSink->FileSize = (u64)lseek(FileSink->File, 0, SEEK_END);
+#endif
+
+    FileSink->FileOpenedAt = Isa__LogNowUs__();
+    return true;
+}
+
+void
+Isa__LogFileSinkCloseFile__(isa__log_file_sink__ *FileSink)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    CloseHandle(FileSink->File);
+#else
+    close(FileSink->File);
+#endif
+}
+
+/**
+ * @note Expects IoLock to be held. Path.N-1 becomes Path.N and so on down to
+ * Path becoming Path.1; whatever was in Path.MaxFiles is lost
+ */
+void
+Isa__LogFileSinkRotate__(isa__log_file_sink__ *FileSink)
+{
+    Isa__LogFileSinkCloseFile__(FileSink);
+
+    char From[ISA__LOG_FILE_SINK_PATH_MAX__ + 16];
+    char To[ISA__LOG_FILE_SINK_PATH_MAX__ + 16];
+    for(u32 i = FileSink->MaxFiles; i > 0; --i)
+    {
+        if(i > 1)
+        {
+            snprintf(From, sizeof(From), "%s.%u", FileSink->Path, i - 1);
+        }
+        else
+        {
+            snprintf(From, sizeof(From), "%s", FileSink->Path);
+        }
+        snprintf(To, sizeof(To), "%s.%u", FileSink->Path, i);
+
+        remove(To);
+        rename(From, To);
+    }
+
+    if(0 == FileSink->MaxFiles)
+    {
+        remove(FileSink->Path);
+    }
+
+    Isa__LogFileSinkOpen__(FileSink);
+}
+
+/**
+ * @note Expects IoLock to be held. Extra is written right after Data in the
+ * same call, which lets lines too big for the buffers skip it
+ */
+void
+Isa__LogFileSinkWriteFile__(isa__log_file_sink__ *FileSink, const char *Data, u64 Len, const char *Extra,
+                            u64 ExtraLen)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    DWORD Written;
+    if(Len > 0)
+    {
+        WriteFile(FileSink->File, Data, (DWORD)Len, &Written, NULL);
+    }
+    if(ExtraLen > 0)
+    {
+        WriteFile(FileSink->File, Extra, (DWORD)ExtraLen, &Written, NULL);
+    }
+#else
+    struct iovec Chunks[2] = {
+        { (void *)Data, Len },
+        { (void *)Extra, ExtraLen },
+    };
+
+    struct iovec *Chunk      = Chunks;
+    int           ChunkCount = 2;
+    while(ChunkCount > 0)
+    {
+        ssize_t Written = writev(FileSink->File, Chunk, ChunkCount);
+        if(Written < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if(Written < 0)
+        {
+            break;
+        }
+
+        while(ChunkCount > 0 && (u64)Written >= Chunk->iov_len)
+        {
+            Written -= (ssize_t)Chunk->iov_len;
+            ++Chunk;
+            --ChunkCount;
+        }
+
+        if(ChunkCount > 0)
+        {
+            Chunk->iov_base = (char *)Chunk->iov_base + Written;
+            Chunk->iov_len -= (u64)Written;
+        }
+    }
+#endif
+
+    FileSink->FileSize += Len + ExtraLen;
+}
+
+/**
+ * @note Expects IoLock to be held
+ */
+void
+Isa__LogFileSinkFlushLocked__(isa__log_file_sink__ *FileSink, const char *Extra, u64 ExtraLen)
+{
+    IsaMutexLock(&FileSink->Lock);
+    char *Full            = FileSink->Active;
+    u64   FullUsed        = FileSink->ActiveUsed;
+    FileSink->Active      = FileSink->Spare;
+    FileSink->ActiveUsed  = 0;
+    FileSink->ActiveSince = 0;
+    FileSink->Spare       = Full;
+    IsaMutexUnlock(&FileSink->Lock);
+
+    if(FullUsed > 0 || ExtraLen > 0)
+    {
+        Isa__LogFileSinkWriteFile__(FileSink, Full, FullUsed, Extra, ExtraLen);
+    }
+
+    bool RotateOnSize = FileSink->RotateSize && (FileSink->FileSize >= FileSink->RotateSize);
+    bool RotateOnTime = FileSink->RotateIntervalUs
+                        && ((Isa__LogNowUs__() - FileSink->FileOpenedAt) >= FileSink->RotateIntervalUs);
+    if(RotateOnSize || RotateOnTime)
+    {
+        Isa__LogFileSinkRotate__(FileSink);
+    }
+}
+
+void
+Isa__LogFileSinkFlush__(isa_log_sink *Sink)
+{
+    isa__log_file_sink__ *FileSink = (isa__log_file_sink__ *)Sink;
+    IsaMutexLock(&FileSink->IoLock);
+    Isa__LogFileSinkFlushLocked__(FileSink, NULL, 0);
+    IsaMutexUnlock(&FileSink->IoLock);
+}
+
+void
+Isa__LogFileSinkPoll__(isa_log_sink *Sink)
+{
+    isa__log_file_sink__ *FileSink = (isa__log_file_sink__ *)Sink;
+
+    IsaMutexLock(&FileSink->Lock);
+    u64 Since = FileSink->ActiveSince;
+    IsaMutexUnlock(&FileSink->Lock);
+
+    bool Overdue     = Since && ((Isa__LogNowUs__() - Since) >= ISA_LOG_FILE_SINK_LATENCY_US);
+    bool RotationDue  = FileSink->RotateIntervalUs
+                       && ((Isa__LogNowUs__() - FileSink->FileOpenedAt) >= FileSink->RotateIntervalUs);
+    if((Overdue || RotationDue) && IsaMutexTryLock(&FileSink->IoLock))
+    {
+        Isa__LogFileSinkFlushLocked__(FileSink, NULL, 0);
+        IsaMutexUnlock(&FileSink->IoLock);
+    }
+}
+
+void
+Isa__LogFileSinkWrite__(isa_log_sink *Sink, const char *Data, u64 Len)
+{
+    isa__log_file_sink__ *FileSink = (isa__log_file_sink__ *)Sink;
+
+    IsaMutexLock(&FileSink->Lock);
+    if((FileSink->ActiveUsed + Len) <= ISA_LOG_FILE_SINK_BUFFER_SIZE)
+    {
+        memcpy(FileSink->Active + FileSink->ActiveUsed, Data, Len);
+        FileSink->ActiveUsed += Len;
+
+        u64 Now = Isa__LogNowUs__();
+        if(0 == FileSink->ActiveSince)
+        {
+            FileSink->ActiveSince = Now;
+        }
+
+        bool Full    = FileSink->ActiveUsed >= (ISA_LOG_FILE_SINK_BUFFER_SIZE / 2);
+        bool Overdue = (Now - FileSink->ActiveSince) >= ISA_LOG_FILE_SINK_LATENCY_US;
+        IsaMutexUnlock(&FileSink->Lock);
+
+        if((Full || Overdue) && IsaMutexTryLock(&FileSink->IoLock))
+        {
+            Isa__LogFileSinkFlushLocked__(FileSink, NULL, 0);
+            IsaMutexUnlock(&FileSink->IoLock);
+        }
+        return;
+    }
+    IsaMutexUnlock(&FileSink->Lock);
+
+    // NOTE(ingar): The buffer is full (or the line is bigger than it), so this
+    // thread has to wait for its turn to write. The line goes out with the
+    // buffered ones, which keeps the order
+    IsaMutexLock(&FileSink->IoLock);
+    Isa__LogFileSinkFlushLocked__(FileSink, Data, Len);
+    IsaMutexUnlock(&FileSink->IoLock);
+}
+
+void
+Isa__LogFileSinkClose__(isa_log_sink *Sink)
+{
+    isa__log_file_sink__ *FileSink = (isa__log_file_sink__ *)Sink;
+    Isa__LogFileSinkFlush__(Sink);
+    Isa__LogFileSinkCloseFile__(FileSink);
+    free(FileSink);
+}
+
+/**
+ * @param RotateSize Rotate once the file reaches this many bytes, 0 for never
+ * @param RotateIntervalSeconds Rotate once the file is this old, 0 for never
+ * @param MaxFiles How many rotated files (Path.1 to Path.MaxFiles) to keep
+ * @return The sink, to be passed to IsaLogAddSink, or NULL
+ */
+isa_log_sink *
+IsaLogFileSinkCreate(const char *Path, u64 RotateSize, u64 RotateIntervalSeconds, u32 MaxFiles)
+{
+    if(strlen(Path) >= ISA__LOG_FILE_SINK_PATH_MAX__)
+    {
+        return NULL;
+    }
+
+    isa__log_file_sink__ *FileSink
+        = (isa__log_file_sink__ *)calloc(1, sizeof(isa__log_file_sink__) + (2 * ISA_LOG_FILE_SINK_BUFFER_SIZE));
+    if(!FileSink)
+    {
+        return NULL;
+    }
+
+    strcpy(FileSink->Path, Path);
+    FileSink->Active           = (char *)(FileSink + 1);
+    FileSink->Spare            = FileSink->Active + ISA_LOG_FILE_SINK_BUFFER_SIZE;
+    FileSink->RotateSize       = RotateSize;
+    FileSink->RotateIntervalUs = RotateIntervalSeconds * 1000000;
+    FileSink->MaxFiles         = MaxFiles;
+    FileSink->Sink.Write       = Isa__LogFileSinkWrite__;
+    FileSink->Sink.Flush       = Isa__LogFileSinkFlush__;
+    FileSink->Sink.Poll        = Isa__LogFileSinkPoll__;
+    FileSink->Sink.Close       = Isa__LogFileSinkClose__;
+    IsaMutexInit(&FileSink->Lock);
+    IsaMutexInit(&FileSink->IoLock);
+
+    if(!Isa__LogFileSinkOpen__(FileSink))
+    {
+        free(FileSink);
+        return NULL;
+    }
+
+    return &FileSink->Sink;
+}
+
+/* The ring file sink copies lines into a fixed-size file mapped into memory,
+ * so logging costs a memcpy and the kernel still has every line written up to
+ * the moment the process dies. Each record starts with a header whose magic is
+ * stored last, and carries a checksum and a sequence number. A reader (see
+ * Tools/isa_log_ring_read.c) can then skip records that were torn by a crash
+ * or partially overwritten when the ring wrapped, and put the rest in order.
+ * Records never straddle the end of the ring; the space left over when one
+ * does not fit is taken by a padding record.
+ *
+ * NOTE(ingar): This protects against the process crashing, not the machine.
+ * Call IsaLogFlushSinks if the pages must reach the disk */
+
+#define ISA_LOG_RING_FILE_MAGIC    "ISARING1"
+#define ISA_LOG_RING_FILE_VERSION  1
+#define ISA_LOG_RING_RECORD_MAGIC  0x52415349U /* "ISAR" */
+#define ISA_LOG_RING_RECORD_PAD    (1U << 0)
+#define ISA_LOG_RING_FILE_MIN_SIZE IsaKibiByte(4)
+
+typedef struct isa_log_ring_file_header
+{
+    char         Magic[8];
+    u32          Version;
+    u32          HeaderSize;
+    u64          Capacity; /* Bytes of records following the header */
+    volatile u64 Cursor;   /* Total bytes ever written, the next record goes at Cursor % Capacity */
+    volatile u64 NextSeq;
+    u8           Reserved[24];
+} isa_log_ring_file_header;
+
+typedef struct isa_log_ring_record
+{
+    volatile u32 Magic;
+    u32          Len; /* Of the data following the record header */
+    u32          Checksum;
+    u32          Flags;
+    u64          Seq;
+} isa_log_ring_record;
+
+#define ISA__LOG_RING_ALIGN__(Size) (((Size) + 7) & ~(u64)7)
+
+/**
+ * @brief FNV-1a over the record's header fields and data
+ */
+u32
+IsaLogRingRecordChecksum(const isa_log_ring_record *Record, const u8 *Data)
+{
+    u32 Hash = 2166136261U;
+
+    u8 Fields[16];
+    memcpy(Fields, &Record->Len, 4);
+    memcpy(Fields + 4, &Record->Flags, 4);
+    memcpy(Fields + 8, &Record->Seq, 8);
+    for(u64 i = 0; i < sizeof(Fields); ++i)
+    {
+        Hash = (Hash ^ Fields[i]) * 16777619U;
+    }
+
+    for(u64 i = 0; i < Record->Len; ++i)
+    {
+        Hash = (Hash ^ Data[i]) * 16777619U;
+    }
+
+    return Hash;
+}
+
+typedef struct isa__log_ring_file_sink__
+{
+    isa_log_sink              Sink;
+    isa_mutex                 Lock;
+    isa_log_ring_file_header *Header;
+    u8                       *Records;
+    u64                       MappingSize;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE File;
+    HANDLE Mapping;
+#else
+    int File;
+#endif
+} isa__log_ring_file_sink__;
+
+/**
+ * @note Expects Lock to be held
+ */
+void
+Isa__LogRingFilePut__(isa__log_ring_file_sink__ *RingSink, u64 Pos, u32 Flags, const char *Data, u32 Len)
+{
+    isa_log_ring_file_header *Header = RingSink->Header;
+    isa_log_ring_record      *Record = (isa_log_ring_record *)(RingSink->Records + Pos);
+
+    // NOTE(ingar): The old magic is cleared first so a crash while the record
+    // is being written leaves something the reader recognizes as garbage
+    IsaAtomicStore32(&Record->Magic, 0);
+    Record->Len   = Len;
+    Record->Flags = Flags;
+    Record->Seq   = Header->NextSeq;
+    if(Len > 0 && Data)
+    {
+        memcpy(Record + 1, Data, Len);
+    }
+    else if(Len > 0)
+    {
+        memset(Record + 1, 0, Len);
+    }
+    Record->Checksum = IsaLogRingRecordChecksum(Record, (const u8 *)(Record + 1));
+    IsaAtomicStore32(&Record->Magic, ISA_LOG_RING_RECORD_MAGIC);
+
+    // NOTE(ingar): Padding shares its number with the record after it so
+    // readers can spot lost records as gaps in the sequence
+    if(!(Flags & ISA_LOG_RING_RECORD_PAD))
+    {
+        IsaAtomicStore64(&Header->NextSeq, Header->NextSeq + 1);
+    }
+    IsaAtomicStore64(&Header->Cursor, Header->Cursor + ISA__LOG_RING_ALIGN__(sizeof(isa_log_ring_record) + Len));
+}
+
+void
+Isa__LogRingFileSinkWrite__(isa_log_sink *Sink, const char *Data, u64 Len)
+{
+    isa__log_ring_file_sink__ *RingSink = (isa__log_ring_file_sink__ *)Sink;
+    isa_log_ring_file_header  *Header   = RingSink->Header;
+
+    u64 MaxLen = Header->Capacity - sizeof(isa_log_ring_record);
+    Len        = IsaMin(Len, MaxLen);
+    u64 Size   = ISA__LOG_RING_ALIGN__(sizeof(isa_log_ring_record) + Len);
+
+    IsaMutexLock(&RingSink->Lock);
+
+    u64 Pos       = Header->Cursor % Header->Capacity;
+    u64 Remaining = Header->Capacity - Pos;
+    if(Remaining < Size)
+    {
+        if(Remaining >= sizeof(isa_log_ring_record))
+        {
+            Isa__LogRingFilePut__(RingSink, Pos, ISA_LOG_RING_RECORD_PAD, NULL,
+                                  (u32)(Remaining - sizeof(isa_log_ring_record)));
+        }
+        else
+        {
+            IsaAtomicStore64(&Header->Cursor, Header->Cursor + Remaining);
+        }
+        Pos = 0;
+    }
+
+    Isa__LogRingFilePut__(RingSink, Pos, 0, Data, (u32)Len);
+
+    IsaMutexUnlock(&RingSink->Lock);
+}
+
+void
+Isa__LogRingFileSinkFlush__(isa_log_sink *Sink)
+{
+    isa__log_ring_file_sink__ *RingSink = (isa__log_ring_file_sink__ *)Sink;
+#if defined(_WIN32) || defined(_WIN64)
+    FlushViewOfFile(RingSink->Header, RingSink->MappingSize);
+#else
+    msync(RingSink->Header, RingSink->MappingSize, MS_ASYNC);
+#endif
+}
+
+void
+Isa__LogRingFileSinkClose__(isa_log_sink *Sink)
+{
+    isa__log_ring_file_sink__ *RingSink = (isa__log_ring_file_sink__ *)Sink;
+    Isa__LogRingFileSinkFlush__(Sink);
+#if defined(_WIN32) || defined(_WIN64)
+    UnmapViewOfFile(RingSink->Header);
+    CloseHandle(RingSink->Mapping);
+    CloseHandle(RingSink->File);
+#else
+    munmap(RingSink->Header, RingSink->MappingSize);
+    close(RingSink->File);
+#endif
+    free(RingSink);
+}
+
+/**
+ * @brief Maps Path as a ring of Capacity bytes. If Path already holds a ring of
+ * the same capacity, e.g. from a run that crashed, writing continues after its
+ * last record instead of starting over
+ * @param Capacity Rounded up to a multiple of 8, and at least
+ * ISA_LOG_RING_FILE_MIN_SIZE
+ * @return The sink, to be passed to IsaLogAddSink, or NULL
+ */
+isa_log_sink *
+IsaLogRingFileSinkCreate(const char *Path, u64 Capacity)
+{
+    Capacity        = ISA__LOG_RING_ALIGN__(IsaMax(Capacity, ISA_LOG_RING_FILE_MIN_SIZE));
+    u64 MappingSize = sizeof(isa_log_ring_file_header) + Capacity;
+
+    isa__log_ring_file_sink__ *RingSink = (isa__log_ring_file_sink__ *)calloc(1, sizeof(isa__log_ring_file_sink__));
+    if(!RingSink)
+    {
+        return NULL;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    RingSink->File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+    if(INVALID_HANDLE_VALUE == RingSink->File)
+    {
+        free(RingSink);
+        return NULL;
+    }
+
+    LARGE_INTEGER Size;
+    Size.QuadPart     = (LONGLONG)MappingSize;
+    RingSink->Mapping = CreateFileMappingA(RingSink->File, NULL, PAGE_READWRITE, Size.HighPart, Size.LowPart, NULL);
+    void *Mapped      = RingSink->Mapping ? MapViewOfFile(RingSink->Mapping, FILE_MAP_WRITE, 0, 0, MappingSize) : NULL;
+    if(!Mapped)
+    {
+        if(RingSink->Mapping)
+        {
+            CloseHandle(RingSink->Mapping);
+        }
+        CloseHandle(RingSink->File);
+        free(RingSink);
+        return NULL;
+    }
+#else
+    RingSink->File = open(Path, O_RDWR | O_CREAT, 0644);
+    if(RingSink->File < 0)
+    {
+        free(RingSink);
+        return NULL;
+    }
+
+    void *Mapped = MAP_FAILED;
+    if(0 == ftruncate(RingSink->File, (off_t)MappingSize))
+    {
+        Mapped = mmap(NULL, MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, RingSink->File, 0);
+    }
+
+    if(MAP_FAILED == Mapped)
+    {
+        close(RingSink->File);
+        free(RingSink);
+        return NULL;
+    }
+#endif
+
+    RingSink->Header      = (isa_log_ring_file_header *)Mapped;
+    RingSink->Records     = (u8 *)Mapped + sizeof(isa_log_ring_file_header);
+    RingSink->MappingSize = MappingSize;
+
+    isa_log_ring_file_header *Header = RingSink->Header;
+    bool Reusable = (0 == memcmp(Header->Magic, ISA_LOG_RING_FILE_MAGIC, 8))
+                    && (ISA_LOG_RING_FILE_VERSION == Header->Version) && (Capacity == Header->Capacity);
+    if(!Reusable)
+    {
+        memset(Mapped, 0, MappingSize);
+        Header->Version    = ISA_LOG_RING_FILE_VERSION;
+        Header->HeaderSize = sizeof(isa_log_ring_file_header);
+        Header->Capacity   = Capacity;
+        IsaAtomicStore64(&Header->NextSeq, 1);
+        IsaAtomicStore64(&Header->Cursor, 0);
+        memcpy(Header->Magic, ISA_LOG_RING_FILE_MAGIC, 8);
+    }
+
+    RingSink->Sink.Write = Isa__LogRingFileSinkWrite__;
+    RingSink->Sink.Flush = Isa__LogRingFileSinkFlush__;
+    RingSink->Sink.Poll  = NULL;
+    RingSink->Sink.Close = Isa__LogRingFileSinkClose__;
+    IsaMutexInit(&RingSink->Lock);
+
+    return &RingSink->Sink;
+}
+
+#if defined(ISA_LOG_ASYNC)
+/* Producers format straight into a per-thread ring of records and a
+ * background thread drains all rings in batches. Call IsaLogAsyncStart to
+ * enable it; until then, and after IsaLogAsyncShutdown, logging is
+ * synchronous */
+
+#if !defined(ISA_LOG_ASYNC_RING_SIZE)
+#define ISA_LOG_ASYNC_RING_SIZE 1024 /* Records per thread, must be a power of two */
+#endif
+
+#if !defined(ISA_LOG_ASYNC_BATCH_SIZE)
+#define ISA_LOG_ASYNC_BATCH_SIZE IsaKibiByte(64)
+#endif
+
+#if !defined(ISA_LOG_ASYNC_FLUSH_INTERVAL_US)
+#define ISA_LOG_ASYNC_FLUSH_INTERVAL_US 1000 /* How long the flusher sleeps when all rings are empty */
+#endif
+
+#define ISA_LOG_ASYNC_DROP      0 /* A full ring discards the new record */
+#define ISA_LOG_ASYNC_OVERWRITE 1 /* A full ring discards its oldest record */
+
+#if !defined(ISA_LOG_ASYNC_POLICY)
+#define ISA_LOG_ASYNC_POLICY ISA_LOG_ASYNC_DROP
+#endif
+
+#define ISA__LOG_ASYNC_NOT_RUNNING__ 1
+
+/* Longest line a ring can hold. It is also kept within the flusher's batch, so
+ * every line can be drained into it. Longer lines are truncated and counted as
+ * dropped */
+#define ISA__LOG_ASYNC_MAX_LINE__                                                                                      \
+    IsaMin((u64)ISA_LOG_ASYNC_RING_SIZE * ISA_LOG_BUF_SIZE, (u64)ISA_LOG_ASYNC_BATCH_SIZE)
+
+/* A line longer than Data carries on in the Data of the slots after it, so a
+ * record takes up as many consecutive slots as its line needs and the producer
+ * never has to allocate. Only the first slot's Len and Slots are used. Tail
+ * always points at the first slot of a record, which is how both the consumer
+ * and, in overwrite mode, the producer know how far to advance it */
+typedef struct isa__log_record__
+{
+    u64  Len;   /* Of the whole line */
+    u64  Slots; /* Including this one */
+    char Data[ISA_LOG_BUF_SIZE];
+} isa__log_record__;
+
+/* Single producer (the owning thread) and single consumer (the flusher). In
+ * overwrite mode the producer also advances Tail, which is why the consumer
+ * claims records with a CAS and throws away its copy if the CAS fails */
+typedef struct isa__log_ring__
+{
+    struct isa__log_ring__ *Next;
+    u8                      Pad0[ISA_CACHE_LINE_SIZE];
+    volatile u64            Head;
+    volatile u64            Dropped;
+    volatile u32            Writing;
+    u8                      Pad1[ISA_CACHE_LINE_SIZE];
+    volatile u64            Tail;
+    u8                      Pad2[ISA_CACHE_LINE_SIZE];
+    isa__log_record__       Records[ISA_LOG_ASYNC_RING_SIZE];
+} isa__log_ring__;
+
+typedef struct isa__log_async_state__
+{
+    isa__log_ring__ *volatile Rings;
+    volatile u32              Running;
+    volatile u32              Stop;
+    volatile u64              FlushRequested;
+    volatile u64              FlushCompleted;
+    u64                       DroppedReported;
+    isa_thread                Flusher;
+    u64                       BatchLen;
+    char                      Batch[ISA_LOG_ASYNC_BATCH_SIZE + 1];
+} isa__log_async_state__;
+
+isa__log_async_state__ *
+Isa__GetLogAsyncState__(void)
+{
+    isa_persist isa__log_async_state__ State = { 0 };
+    return &State;
+}
+
+// NOTE(ingar): Rings are never freed, so the flusher can't race a thread that
+// exits. A thread that stops logging costs one idle ring
+isa__log_ring__ *
+Isa__GetLogRing__(void)
+{
+    isa_persist isa_thread_local isa__log_ring__ *Ring = NULL;
+    if(!Ring)
+    {
+        Ring = (isa__log_ring__ *)calloc(1, sizeof(isa__log_ring__));
+        if(Ring)
+        {
+            isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+            void                   *First = IsaAtomicLoadPtr((void *volatile *)&State->Rings);
+            do
+            {
+                Ring->Next = (isa__log_ring__ *)First;
+            } while(!IsaAtomicCompareExchangePtr((void *volatile *)&State->Rings, &First, Ring));
+        }
+    }
+
+    return Ring;
+}
+
+/**
+ * @brief Makes room for Slots more slots past Head. In overwrite mode the
+ * oldest records are discarded until they fit
+ * @return false if the ring is full and the new record was dropped
+ */
+bool
+Isa__LogAsyncReserve__(isa__log_ring__ *Ring, u64 Slots)
+{
+    u64 Head = Ring->Head;
+    u64 Tail = IsaAtomicLoad64(&Ring->Tail);
+    while((Head + Slots - Tail) > ISA_LOG_ASYNC_RING_SIZE)
+    {
+#if ISA_LOG_ASYNC_POLICY == ISA_LOG_ASYNC_OVERWRITE
+        // NOTE(ingar): Only this thread writes records, so the one at Tail
+        // can't change while its size is read
+        u64 Oldest = Ring->Records[Tail & (ISA_LOG_ASYNC_RING_SIZE - 1)].Slots;
+        if(IsaAtomicCompareExchange64(&Ring->Tail, &Tail, Tail + Oldest))
+        {
+            IsaAtomicStore64(&Ring->Dropped, Ring->Dropped + 1);
+            Tail += Oldest;
+        }
+#else
+        IsaAtomicStore64(&Ring->Dropped, Ring->Dropped + 1);
+        return false;
+#endif
+    }
+
+    return true;
+}
+
+/**
+ * @brief Claims the next record in the calling thread's ring
+ * @return The record, or NULL with Ret set to what the caller should return:
+ * ISA__LOG_ASYNC_NOT_RUNNING__ if it must log synchronously, or 0 if the ring
+ * was full and the record was dropped (which is not an error)
+ * @note Every record returned must be handed to Isa__LogAsyncEnd__
+ */
+isa__log_record__ *
+Isa__LogAsyncBegin__(isa__log_ring__ **RingOut, i64 *Ret)
+{
+    isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+    isa__log_ring__        *Ring  = Isa__GetLogRing__();
+    if(!Ring)
+    {
+        *Ret = ISA__LOG_ASYNC_NOT_RUNNING__;
+        return NULL;
+    }
+
+    // NOTE(ingar): Writing is announced before Running is checked, and
+    // shutdown clears Running before waiting on Writing, so a record can never
+    // be published after the final drain
+    IsaAtomicStore32(&Ring->Writing, 1);
+    IsaAtomicFence();
+    if(!IsaAtomicLoad32(&State->Running))
+    {
+        IsaAtomicStore32(&Ring->Writing, 0);
+        *Ret = ISA__LOG_ASYNC_NOT_RUNNING__;
+        return NULL;
+    }
+
+    if(!Isa__LogAsyncReserve__(Ring, 1))
+    {
+        IsaAtomicStore32(&Ring->Writing, 0);
+        *Ret = 0;
+        return NULL;
+    }
+
+    *RingOut = Ring;
+    return &Ring->Records[Ring->Head & (ISA_LOG_ASYNC_RING_SIZE - 1)];
+}
+
+/**
+ * @brief Publishes Line in the record if Len is not negative. Lines that don't
+ * fit in Data are copied into the slots after it
+ * @param Line Record->Data, or a longer line the record must copy
+ * @param Len Length of Line
+ */
+void
+Isa__LogAsyncEnd__(isa__log_ring__ *Ring, isa__log_record__ *Record, const char *Line, i64 Len)
+{
+    if(Len >= 0)
+    {
+        u64  LineLen   = IsaMin((u64)Len, (u64)ISA__LOG_ASYNC_MAX_LINE__);
+        bool Truncated = LineLen < (u64)Len;
+        u64  Slots     = IsaMax((LineLen + ISA_LOG_BUF_SIZE - 1) / ISA_LOG_BUF_SIZE, (u64)1);
+        if(Truncated)
+        {
+            IsaAtomicStore64(&Ring->Dropped, Ring->Dropped + 1);
+        }
+
+        if(Isa__LogAsyncReserve__(Ring, Slots))
+        {
+            u64 Head = Ring->Head;
+            for(u64 Slot = 0; Slot < Slots; ++Slot)
+            {
+                char *Data  = Ring->Records[(Head + Slot) & (ISA_LOG_ASYNC_RING_SIZE - 1)].Data;
+                u64   Start = Slot * ISA_LOG_BUF_SIZE;
+                if(Line + Start != Data)
+                {
+                    memcpy(Data, Line + Start, IsaMin(LineLen - Start, (u64)ISA_LOG_BUF_SIZE));
+                }
+            }
+
+            if(Truncated && (LineLen > 0))
+            {
+                u64 Last = LineLen - 1;
+                Ring->Records[(Head + (Last / ISA_LOG_BUF_SIZE)) & (ISA_LOG_ASYNC_RING_SIZE - 1)]
+                    .Data[Last % ISA_LOG_BUF_SIZE] = '\n';
+            }
+
+            Record->Len   = LineLen;
+            Record->Slots = Slots;
+            IsaAtomicStore64(&Ring->Head, Head + Slots);
+        }
+    }
+
+    IsaAtomicStore32(&Ring->Writing, 0);
+}
+
+/**
+ * @return ISA__LOG_ASYNC_NOT_RUNNING__ if the caller must log synchronously
+ * (VaArgs is untouched in that case), otherwise the same as Isa__WriteLog__
+ */
+i64
+Isa__LogAsyncWrite__(const char *ModuleName, const char *LogLevel, va_list VaArgs)
+{
+    isa__log_ring__   *Ring   = NULL;
+    i64                Ret    = 0;
+    isa__log_record__ *Record = Isa__LogAsyncBegin__(&Ring, &Ret);
+    if(!Record)
+    {
+        return Ret;
+    }
+
+    // NOTE(ingar): Lines start out in the record and move to the thread's
+    // spill buffer if they outgrow it
+    isa__format_writer__ Writer = { Record->Data, ISA_LOG_BUF_SIZE - 1, 0, Isa__LogGrowLine__ };
+
+    i64 Len = Isa__FormatLog__(&Writer, ModuleName, LogLevel, VaArgs);
+    if((Len >= 0) && ((u64)Len > Writer.Cap))
+    {
+        IsaAtomicStore64(&Ring->Dropped, Ring->Dropped + 1);
+    }
+    Isa__LogAsyncEnd__(Ring, Record, Writer.Buffer, (Len < 0) ? -1 : (i64)IsaMin((u64)Len, Writer.Cap));
+    return (Len < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Queues an already formatted line
+ * @return Same as Isa__LogAsyncWrite__
+ */
+i64
+Isa__LogAsyncWriteLine__(const char *Line, u64 Len)
+{
+    isa__log_ring__   *Ring   = NULL;
+    i64                Ret    = 0;
+    isa__log_record__ *Record = Isa__LogAsyncBegin__(&Ring, &Ret);
+    if(!Record)
+    {
+        return Ret;
+    }
+
+    if(Len < ISA_LOG_BUF_SIZE)
+    {
+        memcpy(Record->Data, Line, Len);
+        Line = Record->Data;
+    }
+    Isa__LogAsyncEnd__(Ring, Record, Line, (i64)Len);
+    return 0;
+}
+
+void
+Isa__LogAsyncOutputBatch__(isa__log_async_state__ *State)
+{
+    if(State->BatchLen > 0)
+    {
+        State->Batch[State->BatchLen] = '\0';
+        Isa__LogOutput__(State->Batch, State->BatchLen);
+        State->BatchLen = 0;
+    }
+}
+
+u64
+Isa__LogAsyncDrain__(isa__log_async_state__ *State)
+{
+    u64 Drained = 0;
+
+    isa__log_ring__ *Ring = (isa__log_ring__ *)IsaAtomicLoadPtr((void *volatile *)&State->Rings);
+    for(; Ring; Ring = Ring->Next)
+    {
+        for(;;)
+        {
+            u64 Tail = IsaAtomicLoad64(&Ring->Tail);
+            u64 Head = IsaAtomicLoad64(&Ring->Head);
+            if(Tail == Head)
+            {
+                break;
+            }
+
+            // NOTE(ingar): In overwrite mode the producer can be rewriting
+            // the record, so a size that doesn't fit between Tail and Head is
+            // torn and the record is retried from the new Tail
+            isa__log_record__ *Record = &Ring->Records[Tail & (ISA_LOG_ASYNC_RING_SIZE - 1)];
+            u64                Slots  = Record->Slots;
+            if((0 == Slots) || (Slots > (Head - Tail)))
+            {
+                continue;
+            }
+
+            u64 Len = IsaMin(Record->Len, (u64)ISA__LOG_ASYNC_MAX_LINE__);
+            if((State->BatchLen + Len) > ISA_LOG_ASYNC_BATCH_SIZE)
+            {
+                Isa__LogAsyncOutputBatch__(State);
+            }
+
+            for(u64 Slot = 0, Start = 0; Start < Len; ++Slot, Start += ISA_LOG_BUF_SIZE)
+            {
+                memcpy(State->Batch + State->BatchLen + Start,
+                       Ring->Records[(Tail + Slot) & (ISA_LOG_ASYNC_RING_SIZE - 1)].Data,
+                       IsaMin(Len - Start, (u64)ISA_LOG_BUF_SIZE));
+            }
+
+            if(IsaAtomicCompareExchange64(&Ring->Tail, &Tail, Tail + Slots))
+            {
+                State->BatchLen += Len;
+                ++Drained;
+            }
+        }
+    }
+
+    return Drained;
+}
+
+/**
+ * @return How many records have been dropped or overwritten, plus how many
+ * lines were truncated because they were too long to queue whole
+ */
+u64
+IsaLogAsyncDroppedCount(void)
+{
+    isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+
+    u64              Dropped = 0;
+    isa__log_ring__ *Ring    = (isa__log_ring__ *)IsaAtomicLoadPtr((void *volatile *)&State->Rings);
+    for(; Ring; Ring = Ring->Next)
+    {
+        Dropped += IsaAtomicLoad64(&Ring->Dropped);
+    }
+
+    return Dropped;
+}
+
+void
+Isa__LogAsyncReportDropped__(isa__log_async_state__ *State)
+{
+    u64 Dropped = IsaLogAsyncDroppedCount();
+    if(Dropped > State->DroppedReported)
+    {
+        Isa__LogAsyncOutputBatch__(State);
+        i64 Len = snprintf(State->Batch, ISA_LOG_ASYNC_BATCH_SIZE, "isa: dropped %llu log records\n",
+                           (unsigned long long)(Dropped - State->DroppedReported));
+        Isa__LogOutput__(State->Batch, (u64)Len);
+        State->DroppedReported = Dropped;
+    }
+}
+
+void
+Isa__LogAsyncFlusher__(void *Arg)
+{
+    isa__log_async_state__ *State = (isa__log_async_state__ *)Arg;
+    for(;;)
+    {
+        // NOTE(ingar): Both are read before draining so the pass that observes
+        // them is guaranteed to see every record published before they were set
+        u64 FlushRequested = IsaAtomicLoad64(&State->FlushRequested);
+        u32 Stop           = IsaAtomicLoad32(&State->Stop);
+
+        u64 Drained = Isa__LogAsyncDrain__(State);
+        Isa__LogAsyncReportDropped__(State);
+        Isa__LogAsyncOutputBatch__(State);
+
+        if(Stop || (FlushRequested != IsaAtomicLoad64(&State->FlushCompleted)))
+        {
+            IsaLogFlushSinks();
+        }
+        else if(0 == Drained)
+        {
+            Isa__LogPollSinks__();
+        }
+
+        IsaAtomicStore64(&State->FlushCompleted, FlushRequested);
+        if(Stop)
+        {
+            break;
+        }
+
+        if(0 == Drained)
+        {
+            IsaSleepMicroseconds(ISA_LOG_ASYNC_FLUSH_INTERVAL_US);
+        }
+    }
+}
+
+bool
+IsaLogAsyncStart(void)
+{
+    isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+    if(IsaAtomicLoad32(&State->Running))
+    {
+        return true;
+    }
+
+    IsaAtomicStore32(&State->Stop, 0);
+    if(!IsaThreadCreate(&State->Flusher, Isa__LogAsyncFlusher__, State))
+    {
+        return false;
+    }
+
+    IsaAtomicStore32(&State->Running, 1);
+    return true;
+}
+
+/**
+ * @brief Blocks until every record logged before the call has been written
+ * and the sinks have been flushed
+ */
+void
+IsaLogAsyncFlush(void)
+{
+    isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+
+    u64 Ticket = IsaAtomicAdd64(&State->FlushRequested, 1) + 1;
+    while(IsaAtomicLoad32(&State->Running) && (IsaAtomicLoad64(&State->FlushCompleted) < Ticket))
+    {
+        IsaSleepMicroseconds(100);
+    }
+}
+
+/**
+ * @brief Stops the flusher after it has written every published record.
+ * Threads that log afterwards fall back to synchronous logging
+ */
+void
+IsaLogAsyncShutdown(void)
+{
+    isa__log_async_state__ *State = Isa__GetLogAsyncState__();
+    if(!IsaAtomicLoad32(&State->Running))
+    {
+        return;
+    }
+
+    IsaAtomicStore32(&State->Running, 0);
+    IsaAtomicFence();
+
+    isa__log_ring__ *Ring = (isa__log_ring__ *)IsaAtomicLoadPtr((void *volatile *)&State->Rings);
+    for(; Ring; Ring = Ring->Next)
+    {
+        while(IsaAtomicLoad32(&Ring->Writing))
+        {
+            IsaSleepMicroseconds(0);
+        }
+    }
+
+    IsaAtomicStore32(&State->Stop, 1);
+    IsaThreadJoin(&State->Flusher);
+}
+
+#endif // ISA_LOG_ASYNC
+
+i64
+Isa__WriteLog__(isa__log_module__ *Module, const char *LogLevel, va_list VaArgs)
+{
+#if defined(ISA_LOG_ASYNC)
+    i64 AsyncRet = Isa__LogAsyncWrite__(Module->Name, LogLevel, VaArgs);
+    if(ISA__LOG_ASYNC_NOT_RUNNING__ != AsyncRet)
+    {
+        return AsyncRet;
+    }
+#endif
+
+    isa__log_thread__ *Thread = Isa__GetLogThread__();
+    if(!Thread)
+    {
+        return -1;
+    }
+
+    // NOTE(ingar): Most lines fit in the thread's line buffer. Longer ones
+    // move to its spill buffer while they are being formatted, so they are
+    // still only formatted once
+    isa__format_writer__ Writer = { Thread->Buffer, ISA_LOG_BUF_SIZE - 1, 0, Isa__LogGrowLine__ };
+
+    i64 Len = Isa__FormatLog__(&Writer, Module->Name, LogLevel, VaArgs);
+    if(Len < 0)
+    {
+        return -1;
+    }
+
+    Isa__LogOutput__(Writer.Buffer, IsaMin((u64)Len, Writer.Cap));
+    return 0;
+}
+
+i64
+Isa__WriteLogIntermediate__(isa__log_module__ *Module, const char *LogLevel, ...)
+{
+    va_list VaArgs;
+    va_start(VaArgs, LogLevel);
+    i64 Ret = Isa__WriteLog__(Module, LogLevel, VaArgs);
+    va_end(VaArgs);
+    return Ret;
+}
+
+i64
+Isa__WriteLogNoModule__(const char *LogLevel, const char *FunctionName, ...)
+{
+    isa__log_module__ Module = {
+        .Name = FunctionName,
+    };
+
+    va_list VaArgs;
+    va_start(VaArgs, FunctionName);
+
+    i64 Ret = Isa__WriteLog__(&Module, LogLevel, VaArgs);
+
+    va_end(VaArgs);
+
+    return Ret;
+}
+
+u64
+Isa__LogTimestampNs__(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    FILETIME FileTime;
+    GetSystemTimePreciseAsFileTime(&FileTime);
+    u64 Ticks = ((u64)FileTime.dwHighDateTime << 32) | FileTime.dwLowDateTime;
+    return (Ticks - 116444736000000000ULL) * 100; /* 100ns ticks since 1601 to ns since 1970 */
+#else
+    struct timespec Time;
+    clock_gettime(CLOCK_REALTIME, &Time);
+    return ((u64)Time.tv_sec * 1000000000ULL) + (u64)Time.tv_nsec;
+#endif
+}
+
+/* Structured logs are a message plus typed key/value fields, encoded straight
+ * into the thread's buffer as one logfmt or JSON Lines record:
+ *
+ *   ts=1760739132.623728 level=INF module=Net msg="request done" status=200
+ *   {"ts":1760739132.623728,"level":"INF","module":"Net","msg":"request done","status":200}
+ *
+ * There is no format string to parse; each field says what it holds:
+ *
+ *   IsaLogInfoFields("request done", IsaLogFieldUint("status", Status), IsaLogFieldStr("path", Path));
+ *
+ * Keys are written as-is in logfmt, so they should not contain spaces, '=' or
+ * quotes. The timestamp is seconds since the Unix epoch in UTC */
+
+#define ISA_LOG_LOGFMT 0
+#define ISA_LOG_JSON   1
+
+#if !defined(ISA_LOG_FIELDS_FORMAT)
+#define ISA_LOG_FIELDS_FORMAT ISA_LOG_LOGFMT
+#endif
+
+enum
+{
+    ISA_LOG_FIELD_INT,
+    ISA_LOG_FIELD_UINT,
+    ISA_LOG_FIELD_FLOAT,
+    ISA_LOG_FIELD_BOOL,
+    ISA_LOG_FIELD_STR,
+};
+
+typedef struct isa_log_field
+{
+    const char *Key;
+    u32         Type;
+    u32         StrLen;
+    union
+    {
+        i64         Int;
+        u64         Uint;
+        f64         Float;
+        bool        Bool;
+        const char *Str;
+    };
+} isa_log_field;
+
+isa_log_field
+IsaLogFieldInt(const char *Key, i64 Value)
+{
+    isa_log_field Field;
+    Field.Key    = Key;
+    Field.Type   = ISA_LOG_FIELD_INT;
+    Field.StrLen = 0;
+    Field.Int    = Value;
+    return Field;
+}
+
+isa_log_field
+IsaLogFieldUint(const char *Key, u64 Value)
+{
+    isa_log_field Field;
+    Field.Key    = Key;
+    Field.Type   = ISA_LOG_FIELD_UINT;
+    Field.StrLen = 0;
+    Field.Uint   = Value;
+    return Field;
+}
+
+isa_log_field
+IsaLogFieldFloat(const char *Key, f64 Value)
+{
+    isa_log_field Field;
+    Field.Key    = Key;
+    Field.Type   = ISA_LOG_FIELD_FLOAT;
+    Field.StrLen = 0;
+    Field.Float  = Value;
+    return Field;
+}
+
+isa_log_field
+IsaLogFieldBool(const char *Key, bool Value)
+{
+    isa_log_field Field;
+    Field.Key    = Key;
+    Field.Type   = ISA_LOG_FIELD_BOOL;
+    Field.StrLen = 0;
+    Field.Bool   = Value;
+    return Field;
+}
+
+/**
+ * @brief For strings that are not null-terminated
+ */
+isa_log_field
+IsaLogFieldStrLen(const char *Key, const char *Value, u32 Len)
+{
+    isa_log_field Field;
+    Field.Key    = Key;
+    Field.Type   = ISA_LOG_FIELD_STR;
+    Field.StrLen = Value ? Len : 0;
+    Field.Str    = Value ? Value : "";
+    return Field;
+}
+
+isa_log_field
+IsaLogFieldStr(const char *Key, const char *Value)
+{
+    return IsaLogFieldStrLen(Key, Value, Value ? (u32)strlen(Value) : 0);
+}
+
+void
+Isa__LogPutFloat__(isa__format_writer__ *Writer, f64 Value)
+{
+    if(Value != Value || Value > DBL_MAX || Value < -DBL_MAX)
+    {
+#if ISA_LOG_FIELDS_FORMAT == ISA_LOG_JSON
+        Isa__FormatPut__(Writer, "null", 4);
+#else
+        const char *Name = (Value != Value) ? "NaN" : (Value > 0) ? "+Inf" : "-Inf";
+        Isa__FormatPut__(Writer, Name, strlen(Name));
+#endif
+        return;
+    }
+
+    Isa__FormatPutShortest__(Writer, Value);
+}
+
+/**
+ * @brief Writes String quoted and escaped, JSON style
+ */
+void
+Isa__LogPutQuoted__(isa__format_writer__ *Writer, const char *String, u64 Len)
+{
+    isa_persist const char Hex[] = "0123456789abcdef";
+
+    Isa__FormatPutChar__(Writer, '"');
+
+    u64 Plain = 0;
+    for(u64 i = 0; i < Len; ++i)
+    {
+        u8 Char = (u8)String[i];
+        if(Char >= 0x20 && Char != '"' && Char != '\\')
+        {
+            continue;
+        }
+
+        Isa__FormatPut__(Writer, String + Plain, i - Plain);
+        Plain = i + 1;
+
+        char Escape[6] = { '\\', (char)Char };
+        u64  EscapeLen = 2;
+        switch(Char)
+        {
+            case '\n':
+            {
+                Escape[1] = 'n';
+            }
+            break;
+            case '\r':
+            {
+                Escape[1] = 'r';
+            }
+            break;
+            case '\t':
+            {
+                Escape[1] = 't';
+            }
+            break;
+            case '"':
+            case '\\':
+                break;
+            default:
+            {
+                Escape[1] = 'u';
+                Escape[2] = '0';
+                Escape[3] = '0';
+                Escape[4] = Hex[Char >> 4];
+                Escape[5] = Hex[Char & 0xF];
+                EscapeLen = 6;
+            }
+            break;
+        }
+        Isa__FormatPut__(Writer, Escape, EscapeLen);
+    }
+
+    Isa__FormatPut__(Writer, String + Plain, Len - Plain);
+    Isa__FormatPutChar__(Writer, '"');
+}
+
+void
+Isa__LogPutString__(isa__format_writer__ *Writer, const char *String, u64 Len)
+{
+#if ISA_LOG_FIELDS_FORMAT == ISA_LOG_LOGFMT
+    // NOTE(ingar): logfmt only needs quotes for values that would otherwise be
+    // ambiguous
+    bool NeedsQuotes = (0 == Len);
+    for(u64 i = 0; i < Len && !NeedsQuotes; ++i)
+    {
+        u8 Char     = (u8)String[i];
+        NeedsQuotes = (Char <= ' ') || (Char == '=') || (Char == '"') || (Char == '\\');
+    }
+
+    if(!NeedsQuotes)
+    {
+        Isa__FormatPut__(Writer, String, Len);
+        return;
+    }
+#endif
+
+    Isa__LogPutQuoted__(Writer, String, Len);
+}
+
+void
+Isa__LogPutKey__(isa__format_writer__ *Writer, const char *Key, bool First)
+{
+#if ISA_LOG_FIELDS_FORMAT == ISA_LOG_JSON
+    Isa__FormatPutChar__(Writer, First ? '{' : ',');
+    Isa__LogPutQuoted__(Writer, Key, strlen(Key));
+    Isa__FormatPutChar__(Writer, ':');
+#else
+    if(!First)
+    {
+        Isa__FormatPutChar__(Writer, ' ');
+    }
+    Isa__FormatPut__(Writer, Key, strlen(Key));
+    Isa__FormatPutChar__(Writer, '=');
+#endif
+}
+
+/**
+ * @brief Encodes a record into Writer, which is set up like for
+ * Isa__FormatLog__
+ * @return Length of the full record, newline included. Like Isa__FormatLog__,
+ * anything above Writer->Cap means it did not fit
+ */
+u64
+Isa__EncodeLogFields__(isa__format_writer__ *Writer, const char *ModuleName, const char *LogLevel,
+                       const char *Message, const isa_log_field *Fields, u64 FieldCount)
+{
+    u64 Now = Isa__LogTimestampNs__();
+    Isa__LogPutKey__(Writer, "ts", true);
+    Isa__FormatPutUint__(Writer, Now / 1000000000ULL);
+    Isa__FormatPutChar__(Writer, '.');
+
+    char Micros[6];
+    u32  Microseconds = (u32)((Now / 1000ULL) % 1000000ULL);
+    for(i32 i = 5; i >= 0; --i)
+    {
+        Micros[i] = (char)('0' + (Microseconds % 10));
+        Microseconds /= 10;
+    }
+    Isa__FormatPut__(Writer, Micros, sizeof(Micros));
+
+    Isa__LogPutKey__(Writer, "level", false);
+    Isa__LogPutString__(Writer, LogLevel, strlen(LogLevel));
+    Isa__LogPutKey__(Writer, "module", false);
+    Isa__LogPutString__(Writer, ModuleName, strlen(ModuleName));
+    Isa__LogPutKey__(Writer, "msg", false);
+    Isa__LogPutQuoted__(Writer, Message, strlen(Message));
+
+    for(u64 i = 0; i < FieldCount; ++i)
+    {
+        const isa_log_field *Field = &Fields[i];
+        Isa__LogPutKey__(Writer, Field->Key, false);
+        switch(Field->Type)
+        {
+            case ISA_LOG_FIELD_INT:
+            {
+                Isa__FormatPutInt__(Writer, Field->Int);
+            }
+            break;
+            case ISA_LOG_FIELD_UINT:
+            {
+                Isa__FormatPutUint__(Writer, Field->Uint);
+            }
+            break;
+            case ISA_LOG_FIELD_FLOAT:
+            {
+                Isa__LogPutFloat__(Writer, Field->Float);
+            }
+            break;
+            case ISA_LOG_FIELD_BOOL:
+            {
+                Isa__FormatPut__(Writer, Field->Bool ? "true" : "false", Field->Bool ? 4 : 5);
+            }
+            break;
+            case ISA_LOG_FIELD_STR:
+            {
+                Isa__LogPutString__(Writer, Field->Str, Field->StrLen);
+            }
+            break;
+        }
+    }
+
+#if ISA_LOG_FIELDS_FORMAT == ISA_LOG_JSON
+    Isa__FormatPutChar__(Writer, '}');
+#endif
+    Isa__FormatPutChar__(Writer, '\n');
+
+    if(Writer->Len <= Writer->Cap)
+    {
+        Writer->Buffer[Writer->Len] = '\0';
+    }
+    else
+    {
+        Writer->Buffer[Writer->Cap - 1] = '\n';
+        Writer->Buffer[Writer->Cap]     = '\0';
+    }
+
+    return Writer->Len;
+}
+
+i64
+Isa__WriteLogFields__(isa__log_module__ *Module, const char *LogLevel, const char *Message,
+                      const isa_log_field *Fields, u64 FieldCount)
+{
+    isa__log_thread__ *Thread = Isa__GetLogThread__();
+    if(!Thread)
+    {
+        return -1;
+    }
+
+    isa__format_writer__ Writer = { Thread->Buffer, ISA_LOG_BUF_SIZE - 1, 0, Isa__LogGrowLine__ };
+
+    u64 Len = Isa__EncodeLogFields__(&Writer, Module->Name, LogLevel, Message, Fields, FieldCount);
+    Len     = IsaMin(Len, Writer.Cap);
+
+#if defined(ISA_LOG_ASYNC)
+    i64 AsyncRet = Isa__LogAsyncWriteLine__(Writer.Buffer, Len);
+    if(ISA__LOG_ASYNC_NOT_RUNNING__ != AsyncRet)
+    {
+        return AsyncRet;
+    }
+#endif
+
+    Isa__LogOutput__(Writer.Buffer, Len);
+    return 0;
+}
+
+#if defined(ISA_LOG_BINARY)
+/* Module logs are written as a call-site ID, a timestamp and the raw argument
+ * bytes. Formatting happens offline in Tools/isa_log_decode.c, which reads the
+ * log together with its call-site table. Call IsaLogBinaryOpen to enable it;
+ * until then module logging is text as usual. Opening truncates both files,
+ * since call-site IDs are only valid for one run. Each site is added to the
+ * table as soon as it is registered, so a log whose process crashed can still
+ * be decoded up to its last flushed record.
+ *
+ * Layout, all little-endian:
+ *   file:   "ISABLOG1" u32 Version, u32 Reserved, then records
+ *   record: u32 SiteId, u32 PayloadSize, u64 TimestampNs, payload
+ *   payload: integers, doubles and pointers as 8 bytes, strings as u32 Len
+ *            followed by Len bytes (no null-terminator)
+ *
+ * NOTE(ingar): A call site's format string is captured on its first call, so
+ * it has to be the same every time (i.e. a literal). Sites whose format
+ * changes, or that use something the encoder can't handle, are logged as text
+ */
+
+#if !defined(ISA_LOG_BINARY_BUFFER_SIZE)
+#define ISA_LOG_BINARY_BUFFER_SIZE IsaKibiByte(64) /* Per thread */
+#endif
+
+#if !defined(ISA_LOG_BINARY_MAX_ARGS)
+#define ISA_LOG_BINARY_MAX_ARGS 16
+#endif
+
+#if !defined(ISA_LOG_BINARY_MAX_STRING)
+#define ISA_LOG_BINARY_MAX_STRING 256 /* Longer string arguments are truncated */
+#endif
+
+#define ISA_LOG_BINARY_MAGIC   "ISABLOG1"
+#define ISA_LOG_BINARY_VERSION 1
+
+#define ISA__LOG_ARG_NONE__    0 /* %% */
+#define ISA__LOG_ARG_INT__     1
+#define ISA__LOG_ARG_LONG__    2
+#define ISA__LOG_ARG_LLONG__   3
+#define ISA__LOG_ARG_SIZE__    4
+#define ISA__LOG_ARG_INTMAX__  5
+#define ISA__LOG_ARG_PTRDIFF__ 6
+#define ISA__LOG_ARG_DOUBLE__  7
+#define ISA__LOG_ARG_LDOUBLE__ 8
+#define ISA__LOG_ARG_STRING__  9
+#define ISA__LOG_ARG_POINTER__ 10
+#define ISA__LOG_ARG_INVALID__ 11
+
+#define ISA__LOG_SITE_NEW__    0
+#define ISA__LOG_SITE_BUSY__   1
+#define ISA__LOG_SITE_BINARY__ 2
+#define ISA__LOG_SITE_TEXT__   3
+
+typedef struct isa__log_spec__
+{
+    const char *Start; /* Points at the '%' */
+    u64         Len;
+    u32         Kind;
+    u32         StarCount; /* Each '*' consumes an int before the value */
+} isa__log_spec__;
+
+/**
+ * @brief Finds the next conversion specification in a printf format string
+ * @return Pointer to the character after the specification, or NULL if there
+ * are no more
+ * @note Shared with the decoder so both sides agree on argument layout
+ */
+const char *
+Isa__LogNextSpec__(const char *Cursor, isa__log_spec__ *Spec)
+{
+    while(*Cursor && '%' != *Cursor)
+    {
+        ++Cursor;
+    }
+
+    if(!*Cursor)
+    {
+        return NULL;
+    }
+
+    Spec->Start     = Cursor++;
+    Spec->StarCount = 0;
+
+    while(*Cursor && strchr("-+ #0", *Cursor))
+    {
+        ++Cursor;
+    }
+
+    for(int Part = 0; Part < 2; ++Part) /* Width, then precision */
+    {
+        if('*' == *Cursor)
+        {
+            ++Spec->StarCount;
+            ++Cursor;
+        }
+        else
+        {
+            while('0' <= *Cursor && *Cursor <= '9')
+            {
+                ++Cursor;
+            }
+        }
+
+        if(0 == Part && '.' == *Cursor)
+        {
+            ++Cursor;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    u32 Length = ISA__LOG_ARG_INT__;
+    switch(*Cursor)
+    {
+        case 'h':
+        {
+            Cursor += ('h' == Cursor[1]) ? 2 : 1;
+        }
+        break;
+        case 'l':
+        {
+            Length = ('l' == Cursor[1]) ? ISA__LOG_ARG_LLONG__ : ISA__LOG_ARG_LONG__;
+            Cursor += ('l' == Cursor[1]) ? 2 : 1;
+        }
+        break;
+        case 'z':
+        {
+            Length = ISA__LOG_ARG_SIZE__;
+            ++Cursor;
+        }
+        break;
+        case 'j':
+        {
+            Length = ISA__LOG_ARG_INTMAX__;
+            ++Cursor;
+        }
+        break;
+        case 't':
+        {
+            Length = ISA__LOG_ARG_PTRDIFF__;
+            ++Cursor;
+        }
+        break;
+        case 'L':
+        {
+            Length = ISA__LOG_ARG_LDOUBLE__;
+            ++Cursor;
+        }
+        break;
+    }
+
+    switch(*Cursor)
+    {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+        {
+            Spec->Kind = (ISA__LOG_ARG_LDOUBLE__ == Length) ? ISA__LOG_ARG_INVALID__ : Length;
+        }
+        break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        case 'r':
+        {
+            Spec->Kind = (ISA__LOG_ARG_LDOUBLE__ == Length) ? ISA__LOG_ARG_LDOUBLE__ : ISA__LOG_ARG_DOUBLE__;
+        }
+        break;
+        case 's':
+        {
+            Spec->Kind = (ISA__LOG_ARG_INT__ == Length) ? ISA__LOG_ARG_STRING__ : ISA__LOG_ARG_INVALID__;
+        }
+        break;
+        case 'p':
+        {
+            Spec->Kind = ISA__LOG_ARG_POINTER__;
+        }
+        break;
+        case '%':
+        {
+            Spec->Kind = ISA__LOG_ARG_NONE__;
+        }
+        break;
+        default:
+        {
+            Spec->Kind = ISA__LOG_ARG_INVALID__;
+        }
+        break;
+    }
+
+    if(*Cursor)
+    {
+        ++Cursor;
+    }
+
+    Spec->Len = (u64)(Cursor - Spec->Start);
+    return Cursor;
+}
+
+typedef struct isa__log_site__
+{
+    const char             *LogLevel;
+    const char             *File;
+    u32                     Line;
+    volatile u64            State;
+    u32                     Id;
+    u32                     ArgCount;
+    u64                     MaxRecordSize;
+    const char             *Format;
+    const char             *ModuleName;
+    struct isa__log_site__ *Next;
+    u8                      ArgKinds[ISA_LOG_BINARY_MAX_ARGS];
+} isa__log_site__;
+
+typedef struct isa__log_binary_buffer__
+{
+    struct isa__log_binary_buffer__ *Next;
+    u64                              Used;
+    u8                               Data[ISA_LOG_BINARY_BUFFER_SIZE];
+} isa__log_binary_buffer__;
+
+typedef struct isa__log_binary_state__
+{
+    isa_mutex                          SiteTableLock; /* Guards SiteTable */
+    FILE                              *SiteTable;
+    volatile u32                       Open;
+    volatile u64                       NextSiteId;
+    isa__log_site__ *volatile          Sites;
+    isa__log_binary_buffer__ *volatile Buffers;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE File;
+#else
+    int File;
+#endif
+} isa__log_binary_state__;
+
+isa__log_binary_state__ *
+Isa__GetLogBinaryState__(void)
+{
+    isa_persist isa__log_binary_state__ State = { ISA_MUTEX_INIT, NULL, 0, 0, NULL, NULL, 0 };
+    return &State;
+}
+
+/**
+ * @brief Writes a call site's line in the site table:
+ * Id<TAB>Level<TAB>Module<TAB>File<TAB>Line<TAB>Format, with backslash, tab
+ * and newline escaped in the format
+ */
+void
+Isa__LogBinaryWriteSiteEntry__(FILE *fd, isa__log_site__ *Site)
+{
+    fprintf(fd, "%u\t%s\t%s\t%s\t%u\t", Site->Id, Site->LogLevel, Site->ModuleName, Site->File, Site->Line);
+    for(const char *c = Site->Format; *c; ++c)
+    {
+        switch(*c)
+        {
+            case '\\':
+            {
+                fputs("\\\\", fd);
+            }
+            break;
+            case '\t':
+            {
+                fputs("\\t", fd);
+            }
+            break;
+            case '\n':
+            {
+                fputs("\\n", fd);
+            }
+            break;
+            default:
+            {
+                fputc(*c, fd);
+            }
+            break;
+        }
+    }
+    fputc('\n', fd);
+}
+
+void
+Isa__LogBinaryWriteFile__(isa__log_binary_state__ *State, const void *Data, u64 Size)
+{
+    // NOTE(ingar): The file is opened for appending, so each write lands in one
+    // piece even when several threads flush at the same time
+#if defined(_WIN32) || defined(_WIN64)
+    DWORD Written;
+    WriteFile(State->File, Data, (DWORD)Size, &Written, NULL);
+#else
+    const u8 *Cursor = (const u8 *)Data;
+    while(Size > 0)
+    {
+        ssize_t Written = write(State->File, Cursor, Size);
+        if(Written <= 0)
+        {
+            break;
+        }
+
+        Cursor += Written;
+        Size -= (u64)Written;
+    }
+#endif
+}
+
+void
+Isa__LogBinaryFlushBuffer__(isa__log_binary_state__ *State, isa__log_binary_buffer__ *Buffer)
+{
+    if(Buffer->Used > 0)
+    {
+        Isa__LogBinaryWriteFile__(State, Buffer->Data, Buffer->Used);
+        Buffer->Used = 0;
+    }
+}
+
+// NOTE(ingar): Like the async rings, buffers are never freed so
+// IsaLogBinaryClose can flush buffers of threads that have exited
+isa__log_binary_buffer__ *
+Isa__GetLogBinaryBuffer__(isa__log_binary_state__ *State)
+{
+    isa_persist isa_thread_local isa__log_binary_buffer__ *Buffer = NULL;
+    if(!Buffer)
+    {
+        Buffer = (isa__log_binary_buffer__ *)calloc(1, sizeof(isa__log_binary_buffer__));
+        if(Buffer)
+        {
+            void *First = IsaAtomicLoadPtr((void *volatile *)&State->Buffers);
+            do
+            {
+                Buffer->Next = (isa__log_binary_buffer__ *)First;
+            } while(!IsaAtomicCompareExchangePtr((void *volatile *)&State->Buffers, &First, Buffer));
+        }
+    }
+
+    return Buffer;
+}
+
+void
+Isa__LogBinaryRegisterSite__(isa__log_binary_state__ *State, isa__log_site__ *Site, const char *ModuleName,
+                             const char *Format)
+{
+    u64 Expected = ISA__LOG_SITE_NEW__;
+    if(!IsaAtomicCompareExchange64(&Site->State, &Expected, ISA__LOG_SITE_BUSY__))
+    {
+        while(ISA__LOG_SITE_BUSY__ == IsaAtomicLoad64(&Site->State))
+        {
+            IsaSleepMicroseconds(0);
+        }
+        return;
+    }
+
+    Site->Format        = Format;
+    Site->ModuleName    = ModuleName;
+    Site->ArgCount      = 0;
+    Site->MaxRecordSize = 16;
+
+    u64             NewState = ISA__LOG_SITE_BINARY__;
+    isa__log_spec__ Spec;
+    const char     *Cursor = Format;
+    while((Cursor = Isa__LogNextSpec__(Cursor, &Spec)))
+    {
+        if(ISA__LOG_ARG_NONE__ == Spec.Kind)
+        {
+            continue;
+        }
+
+        if(ISA__LOG_ARG_INVALID__ == Spec.Kind || (Site->ArgCount + Spec.StarCount + 1) > ISA_LOG_BINARY_MAX_ARGS)
+        {
+            NewState = ISA__LOG_SITE_TEXT__;
+            break;
+        }
+
+        for(u32 i = 0; i < Spec.StarCount; ++i)
+        {
+            Site->ArgKinds[Site->ArgCount++] = ISA__LOG_ARG_INT__;
+            Site->MaxRecordSize += 8;
+        }
+
+        Site->ArgKinds[Site->ArgCount++] = (u8)Spec.Kind;
+        Site->MaxRecordSize += (ISA__LOG_ARG_STRING__ == Spec.Kind) ? (4 + ISA_LOG_BINARY_MAX_STRING) : 8;
+    }
+
+    Site->Id = (u32)IsaAtomicAdd64(&State->NextSiteId, 1) + 1;
+
+    void *First = IsaAtomicLoadPtr((void *volatile *)&State->Sites);
+    do
+    {
+        Site->Next = (isa__log_site__ *)First;
+    } while(!IsaAtomicCompareExchangePtr((void *volatile *)&State->Sites, &First, Site));
+
+    // NOTE(ingar): The entry is flushed before the site's first record can be,
+    // so the table always covers what made it into the log
+    if(ISA__LOG_SITE_BINARY__ == NewState)
+    {
+        IsaMutexLock(&State->SiteTableLock);
+        if(State->SiteTable)
+        {
+            Isa__LogBinaryWriteSiteEntry__(State->SiteTable, Site);
+            fflush(State->SiteTable);
+        }
+        IsaMutexUnlock(&State->SiteTableLock);
+    }
+
+    IsaAtomicStore64(&Site->State, NewState);
+}
+
+i64
+Isa__WriteLogBinary__(isa__log_site__ *Site, isa__log_module__ *Module, ...)
+{
+    isa__log_binary_state__ *State = Isa__GetLogBinaryState__();
+
+    va_list VaArgs;
+    va_start(VaArgs, Module);
+
+    const char *Format = va_arg(VaArgs, const char *);
+    if(!IsaAtomicLoad32(&State->Open))
+    {
+        va_end(VaArgs);
+        va_start(VaArgs, Module);
+        i64 Ret = Isa__WriteLog__(Module, Site->LogLevel, VaArgs);
+        va_end(VaArgs);
+        return Ret;
+    }
+
+    u64 SiteState = IsaAtomicLoad64(&Site->State);
+    if(ISA__LOG_SITE_NEW__ == SiteState || ISA__LOG_SITE_BUSY__ == SiteState)
+    {
+        Isa__LogBinaryRegisterSite__(State, Site, Module->Name, Format);
+        SiteState = IsaAtomicLoad64(&Site->State);
+    }
+
+    isa__log_binary_buffer__ *Buffer = Isa__GetLogBinaryBuffer__(State);
+    if(ISA__LOG_SITE_BINARY__ != SiteState || Format != Site->Format || !Buffer)
+    {
+        va_end(VaArgs);
+        va_start(VaArgs, Module);
+        i64 Ret = Isa__WriteLog__(Module, Site->LogLevel, VaArgs);
+        va_end(VaArgs);
+        return Ret;
+    }
+
+    if((ISA_LOG_BINARY_BUFFER_SIZE - Buffer->Used) < Site->MaxRecordSize)
+    {
+        Isa__LogBinaryFlushBuffer__(State, Buffer);
+    }
+
+    u8 *Record = Buffer->Data + Buffer->Used;
+    u8 *Cursor = Record + 16;
+    for(u32 i = 0; i < Site->ArgCount; ++i)
+    {
+        u64 Bits = 0;
+        switch(Site->ArgKinds[i])
+        {
+            case ISA__LOG_ARG_INT__:
+            {
+                Bits = (u64)(i64)va_arg(VaArgs, int);
+            }
+            break;
+            case ISA__LOG_ARG_LONG__:
+            {
+                Bits = (u64)(i64)va_arg(VaArgs, long);
+            }
+            break;
+            case ISA__LOG_ARG_LLONG__:
+            {
+                Bits = (u64)va_arg(VaArgs, long long);
+            }
+            break;
+            case ISA__LOG_ARG_SIZE__:
+            {
+                Bits = (u64)va_arg(VaArgs, size_t);
+            }
+            break;
+            case ISA__LOG_ARG_INTMAX__:
+            {
+                Bits = (u64)va_arg(VaArgs, intmax_t);
+            }
+            break;
+            case ISA__LOG_ARG_PTRDIFF__:
+            {
+                Bits = (u64)(i64)va_arg(VaArgs, ptrdiff_t);
+            }
+            break;
+            case ISA__LOG_ARG_DOUBLE__:
+            {
+                f64 Value = va_arg(VaArgs, double);
+                memcpy(&Bits, &Value, 8);
+            }
+            break;
+            case ISA__LOG_ARG_LDOUBLE__:
+            {
+                f64 Value = (f64)va_arg(VaArgs, long double);
+                memcpy(&Bits, &Value, 8);
+            }
+            break;
+            case ISA__LOG_ARG_POINTER__:
+            {
+                Bits = (u64)(uintptr_t)va_arg(VaArgs, void *);
+            }
+            break;
+            case ISA__LOG_ARG_STRING__:
+            {
+                const char *String = va_arg(VaArgs, const char *);
+                if(!String)
+                {
+                    String = "(null)";
+                }
+
+                u32 Len = 0;
+                while(Len < ISA_LOG_BINARY_MAX_STRING && String[Len])
+                {
+                    ++Len;
+                }
+
+                memcpy(Cursor, &Len, 4);
+                memcpy(Cursor + 4, String, Len);
+                Cursor += 4 + Len;
+            }
+            continue;
+        }
+
+        memcpy(Cursor, &Bits, 8);
+        Cursor += 8;
+    }
+
+    va_end(VaArgs);
+
+    u32 SiteId      = Site->Id;
+    u32 PayloadSize = (u32)(Cursor - Record - 16);
+    u64 Timestamp   = Isa__LogTimestampNs__();
+    memcpy(Record, &SiteId, 4);
+    memcpy(Record + 4, &PayloadSize, 4);
+    memcpy(Record + 8, &Timestamp, 8);
+
+    Buffer->Used += (u64)(Cursor - Record);
+    return 0;
+}
+
+bool
+IsaLogBinaryOpen(const char *LogPath, const char *SiteTablePath)
+{
+    isa__log_binary_state__ *State = Isa__GetLogBinaryState__();
+    if(IsaAtomicLoad32(&State->Open))
+    {
+        return false;
+    }
+
+    FILE *SiteTable = NULL;
+    if(SiteTablePath)
+    {
+        SiteTable = fopen(SiteTablePath, "wb");
+        if(!SiteTable)
+        {
+            return false;
+        }
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    State->File
+        = CreateFileA(LogPath, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(INVALID_HANDLE_VALUE == State->File)
+#else
+    State->File = open(LogPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if(State->File < 0)
+#endif
+    {
+        if(SiteTable)
+        {
+            fclose(SiteTable);
+        }
+        return false;
+    }
+
+    u8  Header[16];
+    u32 Version  = ISA_LOG_BINARY_VERSION;
+    u32 Reserved = 0;
+    memcpy(Header, ISA_LOG_BINARY_MAGIC, 8);
+    memcpy(Header + 8, &Version, 4);
+    memcpy(Header + 12, &Reserved, 4);
+    Isa__LogBinaryWriteFile__(State, Header, sizeof(Header));
+
+    // NOTE(ingar): Sites keep their IDs across a close and reopen, so the ones
+    // registered in an earlier session start off the new table
+    IsaMutexLock(&State->SiteTableLock);
+    State->SiteTable = SiteTable;
+    if(SiteTable)
+    {
+        isa__log_site__ *Site = (isa__log_site__ *)IsaAtomicLoadPtr((void *volatile *)&State->Sites);
+        for(; Site; Site = Site->Next)
+        {
+            if(ISA__LOG_SITE_BINARY__ == IsaAtomicLoad64(&Site->State))
+            {
+                Isa__LogBinaryWriteSiteEntry__(SiteTable, Site);
+            }
+        }
+        fflush(SiteTable);
+    }
+    IsaMutexUnlock(&State->SiteTableLock);
+
+    IsaAtomicStore32(&State->Open, 1);
+    return true;
+}
+
+/**
+ * @brief Writes the calling thread's buffered records to the log
+ */
+void
+IsaLogBinaryFlush(void)
+{
+    isa__log_binary_state__ *State = Isa__GetLogBinaryState__();
+    if(IsaAtomicLoad32(&State->Open))
+    {
+        Isa__LogBinaryFlushBuffer__(State, Isa__GetLogBinaryBuffer__(State));
+    }
+}
+
+/**
+ * @brief Writes the line of every registered call site to Path, in the same
+ * format as the table IsaLogBinaryOpen keeps
+ */
+bool
+IsaLogBinaryWriteSiteTable(const char *Path)
+{
+    FILE *fd = fopen(Path, "wb");
+    if(!fd)
+    {
+        fprintf(stderr, "Unable to open file %s!\n", Path);
+        return false;
+    }
+
+    isa__log_binary_state__ *State = Isa__GetLogBinaryState__();
+    isa__log_site__         *Site  = (isa__log_site__ *)IsaAtomicLoadPtr((void *volatile *)&State->Sites);
+    for(; Site; Site = Site->Next)
+    {
+        if(ISA__LOG_SITE_BINARY__ == IsaAtomicLoad64(&Site->State))
+        {
+            Isa__LogBinaryWriteSiteEntry__(fd, Site);
+        }
+    }
+
+    bool WriteSuccessful = !ferror(fd);
+    fclose(fd);
+    return WriteSuccessful;
+}
+
+/**
+ * @brief Flushes every thread's buffer and closes the log and its call-site
+ * table. Module logging is text afterwards
+ * @note Other threads must have stopped logging
+ */
+void
+IsaLogBinaryClose(void)
+{
+    isa__log_binary_state__ *State = Isa__GetLogBinaryState__();
+    if(!IsaAtomicLoad32(&State->Open))
+    {
+        return;
+    }
+
+    IsaAtomicStore32(&State->Open, 0);
+
+    isa__log_binary_buffer__ *Buffer
+        = (isa__log_binary_buffer__ *)IsaAtomicLoadPtr((void *volatile *)&State->Buffers);
+    for(; Buffer; Buffer = Buffer->Next)
+    {
+        Isa__LogBinaryFlushBuffer__(State, Buffer);
+    }
+
+    IsaMutexLock(&State->SiteTableLock);
+    if(State->SiteTable)
+    {
+        fclose(State->SiteTable);
+        State->SiteTable = NULL;
+    }
+    IsaMutexUnlock(&State->SiteTableLock);
+
+#if defined(_WIN32) || defined(_WIN64)
+    CloseHandle(State->File);
+#else
+    close(State->File);
+#endif
+}
+
+#endif // ISA_LOG_BINARY
+
+#define ISA_LOG_LEVEL_NONE (0U)
+#define ISA_LOG_LEVEL_ERR  (1U)
+#define ISA_LOG_LEVEL_WRN  (2U)
+#define ISA_LOG_LEVEL_INF  (3U)
+#define ISA_LOG_LEVEL_DBG  (4U)
+
+/* Log calls above this level compile to nothing, arguments included */
+#if !defined(ISA_LOG_LEVEL)
+#if defined(NDEBUG)
+#define ISA_LOG_LEVEL ISA_LOG_LEVEL_WRN
+#else
+#define ISA_LOG_LEVEL ISA_LOG_LEVEL_DBG
+#endif
+#endif
+
+#define ISA__LOG_LEVEL_CHECK__(level) (ISA_LOG_LEVEL >= ISA_LOG_LEVEL_##level ? 1 : 0)
+
+/* Each module also has a runtime level, checked with a single relaxed load
+ * after the compile-time check. Levels come from rules of the form
+ * "Module=LVL" and "*=LVL" (or just "LVL") for every other module, separated by
+ * commas, semicolons or whitespace. LVL is NONE, ERR, WRN, INF, DBG or 0-4.
+ * Rules are read from the ISA_LOG_LEVELS environment variable the first time
+ * anything is logged, and can be changed at any time with IsaLogSetLevels,
+ * IsaLogSetModuleLevel or IsaLogLoadLevelFile.
+ *
+ * A module's level is resolved the first time it logs, which is also when it
+ * is registered, so rules set later still reach it */
+
+#if !defined(ISA_LOG_LEVEL_ENV)
+#define ISA_LOG_LEVEL_ENV "ISA_LOG_LEVELS"
+#endif
+
+#if !defined(ISA_LOG_MAX_LEVEL_RULES)
+#define ISA_LOG_MAX_LEVEL_RULES 64
+#endif
+
+#define ISA__LOG_LEVEL_UNSET__    0xFFFFFFFFU
+#define ISA__LOG_MODULE_NAME_MAX__ 64
+
+typedef struct isa__log_level_rule__
+{
+    char Module[ISA__LOG_MODULE_NAME_MAX__];
+    u32  Level;
+} isa__log_level_rule__;
+
+typedef struct isa__log_level_state__
+{
+    isa_mutex             Lock;
+    volatile u32          Initialized; /* Read without the lock by Isa__LogDefaultLevel__ */
+    volatile u32          DefaultLevel;
+    isa__log_module__    *Modules;
+    u32                   RuleCount;
+    isa__log_level_rule__ Rules[ISA_LOG_MAX_LEVEL_RULES];
+} isa__log_level_state__;
+
+u32
+Isa__LogParseLevel__(const char *Name, u64 Len)
+{
+    isa_persist const char *Names[] = { "NONE", "ERR", "WRN", "INF", "DBG" };
+    for(u32 Level = 0; Level < IsaArrayLen(Names); ++Level)
+    {
+        if((1 == Len && ('0' + Level) == (u32)Name[0])
+           || (Len == strlen(Names[Level]) && 0 == strncmp(Name, Names[Level], Len)))
+        {
+            return Level;
+        }
+    }
+
+    return ISA__LOG_LEVEL_UNSET__;
+}
+
+/**
+ * @note Expects the state lock to be held
+ */
+u32
+Isa__LogResolveLevel__(isa__log_level_state__ *State, const char *ModuleName)
+{
+    for(u32 i = 0; i < State->RuleCount; ++i)
+    {
+        if(0 == strcmp(State->Rules[i].Module, ModuleName))
+        {
+            return State->Rules[i].Level;
+        }
+    }
+
+    return State->DefaultLevel;
+}
+
+/**
+ * @note Expects the state lock to be held
+ */
+void
+Isa__LogApplyLevels__(isa__log_level_state__ *State)
+{
+    for(isa__log_module__ *Module = State->Modules; Module; Module = Module->Next)
+    {
+        IsaAtomicStore32(&Module->Level, Isa__LogResolveLevel__(State, Module->Name));
+    }
+}
+
+/**
+ * @note Expects the state lock to be held
+ */
+bool
+Isa__LogSetRule__(isa__log_level_state__ *State, const char *Module, u64 ModuleLen, u32 Level)
+{
+    if(0 == ModuleLen || (1 == ModuleLen && '*' == Module[0]))
+    {
+        IsaAtomicStore32(&State->DefaultLevel, Level);
+        return true;
+    }
+
+    if(ModuleLen >= ISA__LOG_MODULE_NAME_MAX__)
+    {
+        return false;
+    }
+
+    u32 RuleIdx = 0;
+    for(; RuleIdx < State->RuleCount; ++RuleIdx)
+    {
+        if(0 == strncmp(State->Rules[RuleIdx].Module, Module, ModuleLen)
+           && '\0' == State->Rules[RuleIdx].Module[ModuleLen])
+        {
+            break;
+        }
+    }
+
+    if(RuleIdx == State->RuleCount)
+    {
+        if(State->RuleCount == ISA_LOG_MAX_LEVEL_RULES)
+        {
+            return false;
+        }
+
+        ++State->RuleCount;
+        memcpy(State->Rules[RuleIdx].Module, Module, ModuleLen);
+        State->Rules[RuleIdx].Module[ModuleLen] = '\0';
+    }
+
+    State->Rules[RuleIdx].Level = Level;
+    return true;
+}
+
+/**
+ * @note Expects the state lock to be held. Everything after a '#' on a line is
+ * ignored, so the same parser handles level files
+ */
+bool
+Isa__LogParseLevels__(isa__log_level_state__ *State, const char *Spec)
+{
+    bool        Valid  = true;
+    const char *Cursor = Spec;
+    while(*Cursor)
+    {
+        if('#' == *Cursor)
+        {
+            while(*Cursor && '\n' != *Cursor)
+            {
+                ++Cursor;
+            }
+            continue;
+        }
+
+        if(strchr(",; \t\r\n", *Cursor))
+        {
+            ++Cursor;
+            continue;
+        }
+
+        const char *Rule = Cursor;
+        while(*Cursor && !strchr(",; \t\r\n#", *Cursor))
+        {
+            ++Cursor;
+        }
+
+        const char *Equals    = (const char *)memchr(Rule, '=', (u64)(Cursor - Rule));
+        const char *LevelName = Equals ? Equals + 1 : Rule;
+        u64         ModuleLen = Equals ? (u64)(Equals - Rule) : 0;
+        u32         Level     = Isa__LogParseLevel__(LevelName, (u64)(Cursor - LevelName));
+
+        if(ISA__LOG_LEVEL_UNSET__ == Level || !Isa__LogSetRule__(State, Rule, ModuleLen, Level))
+        {
+            Valid = false;
+        }
+    }
+
+    return Valid;
+}
+
+isa__log_level_state__ *
+Isa__GetLogLevelState__(void)
+{
+    isa_persist isa__log_level_state__ State = { ISA_MUTEX_INIT, 0, 0, NULL, 0, { { { 0 }, 0 } } };
+    return &State;
+}
+
+/**
+ * @note Expects the state lock to be held
+ */
+void
+Isa__LogInitLevels__(isa__log_level_state__ *State)
+{
+    if(!IsaAtomicLoadRelaxed32(&State->Initialized))
+    {
+        State->DefaultLevel = ISA_LOG_LEVEL;
+
+        const char *Spec = getenv(ISA_LOG_LEVEL_ENV);
+        if(Spec)
+        {
+            Isa__LogParseLevels__(State, Spec);
+        }
+
+        // NOTE(ingar): Set last, so a thread that sees it without taking the
+        // lock also sees the default level the environment gave
+        IsaAtomicStore32(&State->Initialized, 1);
+    }
+}
+
+ISA_COLD u32
+Isa__LogRegisterModule__(isa__log_module__ *Module)
+{
+    isa__log_level_state__ *State = Isa__GetLogLevelState__();
+    IsaMutexLock(&State->Lock);
+    Isa__LogInitLevels__(State);
+
+    if(ISA__LOG_LEVEL_UNSET__ == Module->Level)
+    {
+        Module->Next   = State->Modules;
+        State->Modules = Module;
+        IsaAtomicStore32(&Module->Level, Isa__LogResolveLevel__(State, Module->Name));
+    }
+
+    u32 Level = Module->Level;
+    IsaMutexUnlock(&State->Lock);
+
+    return Level;
+}
+
+u32
+Isa__LogModuleLevel__(isa__log_module__ *Module)
+{
+    u32 Level = IsaAtomicLoadRelaxed32(&Module->Level);
+    if(ISA_UNLIKELY(ISA__LOG_LEVEL_UNSET__ == Level))
+    {
+        Level = Isa__LogRegisterModule__(Module);
+    }
+
+    return Level;
+}
+
+/* Used by the no-module macros */
+u32
+Isa__LogDefaultLevel__(void)
+{
+    isa__log_level_state__ *State = Isa__GetLogLevelState__();
+    if(ISA_UNLIKELY(!IsaAtomicLoad32(&State->Initialized)))
+    {
+        IsaMutexLock(&State->Lock);
+        Isa__LogInitLevels__(State);
+        IsaMutexUnlock(&State->Lock);
+    }
+
+    return IsaAtomicLoadRelaxed32(&State->DefaultLevel);
+}
+
+/**
+ * @brief Adds or updates rules, e.g. "Net=DBG,*=WRN"
+ * @return false if any rule was invalid; the valid ones are still applied
+ */
+bool
+IsaLogSetLevels(const char *Spec)
+{
+    isa__log_level_state__ *State = Isa__GetLogLevelState__();
+    IsaMutexLock(&State->Lock);
+    Isa__LogInitLevels__(State);
+
+    bool Valid = Isa__LogParseLevels__(State, Spec);
+    Isa__LogApplyLevels__(State);
+
+    IsaMutexUnlock(&State->Lock);
+    return Valid;
+}
+
+/**
+ * @param ModuleName The name given to ISA_LOG_REGISTER, or "*" for the default
+ */
+bool
+IsaLogSetModuleLevel(const char *ModuleName, u32 Level)
+{
+    isa__log_level_state__ *State = Isa__GetLogLevelState__();
+    IsaMutexLock(&State->Lock);
+    Isa__LogInitLevels__(State);
+
+    bool Valid = Isa__LogSetRule__(State, ModuleName, strlen(ModuleName), IsaMin(Level, ISA_LOG_LEVEL_DBG));
+    Isa__LogApplyLevels__(State);
+
+    IsaMutexUnlock(&State->Lock);
+    return Valid;
+}
+
+/**
+ * @brief Replaces all rules with the ones in the file, so it can be called
+ * again to reload it (e.g. on SIGHUP). Modules without a rule in the file go
+ * back to the default, which is ISA_LOG_LEVEL unless the file sets "*"
+ */
+bool
+IsaLogLoadLevelFile(const char *Path)
+{
+    isa_file_data *File = IsaLoadFileIntoMemory(Path);
+    if(!File)
+    {
+        return false;
+    }
+
+    isa__log_level_state__ *State = Isa__GetLogLevelState__();
+    IsaMutexLock(&State->Lock);
+    Isa__LogInitLevels__(State);
+
+    State->RuleCount = 0;
+    IsaAtomicStore32(&State->DefaultLevel, ISA_LOG_LEVEL);
+
+    bool Valid = Isa__LogParseLevels__(State, (const char *)File->Data);
+    Isa__LogApplyLevels__(State);
+
+    IsaMutexUnlock(&State->Lock);
+    free(File);
+
+    return Valid;
+}
+
+/* Call sites in hot loops can be thinned out with the EveryN, FirstN and
+ * RateLimited variants of the log macros. Each call site gets its own limiter,
+ * and a call that is rejected costs one relaxed counter increment (plus a
+ * coarse clock read for RateLimited) before any formatting or level lookup.
+ * Rejected calls are summarized in a "suppressed" line from the same module:
+ * FirstN reports after 1, 2, 4, 8... suppressed calls, RateLimited when the
+ * next one-second window opens. Counts are approximate when several threads
+ * share a call site. An n of 0 logs nothing, for EveryN as well as FirstN */
+
+typedef struct isa__log_limiter__
+{
+    volatile u64 Calls;
+    volatile u64 WindowStart; /* In microseconds, RateLimited only */
+    volatile u64 WindowCalls;
+    volatile u64 Suppressed;
+} isa__log_limiter__;
+
+u64
+Isa__LogCoarseNowUs__(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return GetTickCount64() * 1000;
+#elif defined(CLOCK_MONOTONIC_COARSE)
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &Now);
+    return ((u64)Now.tv_sec * 1000000ULL) + ((u64)Now.tv_nsec / 1000);
+#else
+    return Isa__LogNowUs__();
+#endif
+}
+
+/**
+ * @return The number of calls suppressed since the last window if this call
+ * opened a new one, otherwise 0
+ */
+u64
+Isa__LogRateWindow__(isa__log_limiter__ *Limiter)
+{
+    u64 Now   = Isa__LogCoarseNowUs__();
+    u64 Start = IsaAtomicLoad64(&Limiter->WindowStart);
+    if((Now - Start) < 1000000 || !IsaAtomicCompareExchange64(&Limiter->WindowStart, &Start, Now))
+    {
+        return 0;
+    }
+
+    IsaAtomicStore64(&Limiter->WindowCalls, 0);
+    u64 Suppressed = IsaAtomicLoad64(&Limiter->Suppressed);
+    IsaAtomicAdd64(&Limiter->Suppressed, (u64)0 - Suppressed);
+    return Suppressed;
+}
+
+ISA_COLD void
+Isa__LogSuppressed__(isa__log_module__ *Module, const char *LogLevel, u64 Count, const char *File, int Line)
+{
+    Isa__WriteLogIntermediate__(Module, LogLevel, "suppressed %llu messages from %s:%d", (unsigned long long)Count,
+                                File, Line);
+}
+
+#if !defined(ISA_LOG_OVERRIDE)
+#define ISA_LOG_REGISTER(module_name)                                                                                  \
+    isa_global isa__log_module__ ISA_CONCAT3(Isa__LogModule, module_name, __)                                          \
+        = { .Name = #module_name, .Level = ISA__LOG_LEVEL_UNSET__ };                                                   \
+    isa_global ISA_UNUSED isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, module_name, __)
+
+#define ISA_LOG_DECLARE_EXTERN(name)                                                                                   \
+    extern isa__log_module__      ISA_CONCAT3(Isa__LogModule, name, __);                                               \
+    isa_global ISA_UNUSED isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, name, __)
+
+#else /* ISA_LOG_OVERRIDE */
+/* This allows files with different module names to be included in the same TU
+ * by overriding their module names */
+
+#define ISA_LOG_REGISTER_OVERRIDE(module_name)                                                                         \
+    isa_global isa__log_module__ ISA_CONCAT3(Isa__LogModule, module_name, __)                                          \
+        = { .Name = #module_name, .Level = ISA__LOG_LEVEL_UNSET__ };                                                   \
+    isa_global ISA_UNUSED isa__log_module__ *Isa__LogInstance__ = &ISA_CONCAT3(Isa__LogModule, module_name, __)
+
+#define ISA_LOG_REGISTER(name)       extern isa__log_module__ *Isa__LogInstance__
+#define ISA_LOG_DECLARE_EXTERN(name) extern isa__log_module__ *Isa__LogInstance__
+
+#endif /* ISA_LOG_OVERRIDE */
+
+#define ISA_LOG_DECLARE_SAME_TU extern struct isa__log_module__ *Isa__LogInstance__
+
+#if defined(ISA_LOG_BINARY)
+#define ISA__LOG_SITE__(log_level)                                                                                     \
+    isa_persist isa__log_site__ Isa__LogSite__                                                                         \
+        = { ISA_STRINGIFY(log_level), __FILE__, __LINE__, 0, 0, 0, 0, NULL, NULL, NULL, { 0 } }
+#define ISA__LOG_WRITE__(log_level, ...) Isa__WriteLogBinary__(&Isa__LogSite__, Isa__LogInstance__, __VA_ARGS__)
+#else
+#define ISA__LOG_SITE__(log_level)
+#define ISA__LOG_WRITE__(log_level, ...)                                                                               \
+    Isa__WriteLogIntermediate__(Isa__LogInstance__, ISA_STRINGIFY(log_level), __VA_ARGS__)
+#endif // ISA_LOG_BINARY
+
+#define ISA__LOG__(log_level, ...)                                                                                     \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level)                                                                           \
+           && (Isa__LogModuleLevel__(Isa__LogInstance__) >= ISA_LOG_LEVEL_##log_level))                                \
+        {                                                                                                              \
+            ISA__LOG_SITE__(log_level);                                                                                \
+            i64 Ret = ISA__LOG_WRITE__(log_level, __VA_ARGS__);                                                        \
+            if(Ret)                                                                                                    \
+            {                                                                                                          \
+                Isa__LogPrint__("\n\nERROR WHILE LOGGING\n\n");                                                        \
+                assert(0);                                                                                             \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+#define ISA__LOG_NO_MODULE__(log_level, ...)                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level) && (Isa__LogDefaultLevel__() >= ISA_LOG_LEVEL_##log_level))               \
+        {                                                                                                              \
+            i64 Ret = Isa__WriteLogNoModule__(ISA_STRINGIFY(log_level), __func__, __VA_ARGS__);                        \
+            if(Ret)                                                                                                    \
+            {                                                                                                          \
+                Isa__LogPrint__("\n\nERROR WHILE LOGGING\n\n");                                                        \
+                assert(0);                                                                                             \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+/* The message is split from the fields inside the macro, since a call with no
+ * fields would otherwise leave the variadic part empty. The fields always get
+ * a trailing sentinel, which keeps the array from being empty and is not
+ * counted */
+#define ISA__LOG_FIELDS_MESSAGE__(message, ...) message
+#define ISA__LOG_FIELDS_LIST__(message, ...)    __VA_ARGS__
+#define ISA__LOG_FIELDS_END__                   IsaLogFieldInt(NULL, 0)
+
+#define ISA__LOG_FIELDS__(log_level, ...)                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level)                                                                           \
+           && (Isa__LogModuleLevel__(Isa__LogInstance__) >= ISA_LOG_LEVEL_##log_level))                                \
+        {                                                                                                              \
+            isa_log_field Isa__LogFields__[]                                                                           \
+                = { ISA_EXPAND(ISA__LOG_FIELDS_LIST__(__VA_ARGS__, ISA__LOG_FIELDS_END__)) };                          \
+                                                                                                                       \
+            i64 Ret = Isa__WriteLogFields__(Isa__LogInstance__, ISA_STRINGIFY(log_level),                              \
+                                            ISA_EXPAND(ISA__LOG_FIELDS_MESSAGE__(__VA_ARGS__, 0)), Isa__LogFields__,   \
+                                            IsaArrayLen(Isa__LogFields__) - 1);                                        \
+            if(Ret)                                                                                                    \
+            {                                                                                                          \
+                Isa__LogPrint__("\n\nERROR WHILE LOGGING\n\n");                                                        \
+                assert(0);                                                                                             \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+#define ISA__LOG_EVERY_N__(log_level, n, ...)                                                                          \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level))                                                                          \
+        {                                                                                                              \
+            isa_persist isa__log_limiter__ Isa__LogLimiter__;                                                          \
+            u64                            Isa__LogEvery__ = (u64)(n);                                                 \
+            if(Isa__LogEvery__ && (0 == (IsaAtomicAddRelaxed64(&Isa__LogLimiter__.Calls, 1) % Isa__LogEvery__)))       \
+            {                                                                                                          \
+                ISA__LOG__(log_level, __VA_ARGS__);                                                                    \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+#define ISA__LOG_FIRST_N__(log_level, n, ...)                                                                          \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level))                                                                          \
+        {                                                                                                              \
+            isa_persist isa__log_limiter__ Isa__LogLimiter__;                                                          \
+            u64                            Isa__LogFirst__ = (u64)(n);                                                 \
+            u64                            Isa__LogCalls__ = IsaAtomicAddRelaxed64(&Isa__LogLimiter__.Calls, 1);       \
+            if(Isa__LogCalls__ < Isa__LogFirst__)                                                                      \
+            {                                                                                                          \
+                ISA__LOG__(log_level, __VA_ARGS__);                                                                    \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                u64 Isa__LogSkipped__ = (Isa__LogCalls__ - Isa__LogFirst__) + 1;                                       \
+                if(ISA_UNLIKELY(0 == (Isa__LogSkipped__ & (Isa__LogSkipped__ - 1)))                                    \
+                   && (Isa__LogModuleLevel__(Isa__LogInstance__) >= ISA_LOG_LEVEL_##log_level))                        \
+                {                                                                                                      \
+                    Isa__LogSuppressed__(Isa__LogInstance__, ISA_STRINGIFY(log_level), Isa__LogSkipped__, __FILE__,    \
+                                         __LINE__);                                                                    \
+                }                                                                                                      \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+#define ISA__LOG_RATE_LIMITED__(log_level, per_second, ...)                                                            \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA__LOG_LEVEL_CHECK__(log_level))                                                                          \
+        {                                                                                                              \
+            isa_persist isa__log_limiter__ Isa__LogLimiter__;                                                          \
+            u64                            Isa__LogSuppressedCount__ = Isa__LogRateWindow__(&Isa__LogLimiter__);       \
+            if(ISA_UNLIKELY(Isa__LogSuppressedCount__)                                                                 \
+               && (Isa__LogModuleLevel__(Isa__LogInstance__) >= ISA_LOG_LEVEL_##log_level))                            \
+            {                                                                                                          \
+                Isa__LogSuppressed__(Isa__LogInstance__, ISA_STRINGIFY(log_level), Isa__LogSuppressedCount__,          \
+                                     __FILE__, __LINE__);                                                              \
+            }                                                                                                          \
+            if(IsaAtomicAddRelaxed64(&Isa__LogLimiter__.WindowCalls, 1) < (u64)(per_second))                           \
+            {                                                                                                          \
+                ISA__LOG__(log_level, __VA_ARGS__);                                                                    \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                IsaAtomicAddRelaxed64(&Isa__LogLimiter__.Suppressed, 1);                                               \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+#define ISA__LOG_DISABLED__(...)                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+    } while(0)
+
+#if ISA_LOG_LEVEL >= ISA_LOG_LEVEL_DBG
+#define IsaLogDebug(...)                        ISA__LOG__(DBG, __VA_ARGS__)
+#define IsaLogDebugNoModule(...)                ISA__LOG_NO_MODULE__(DBG, __VA_ARGS__)
+#define IsaLogDebugFields(...)                  ISA__LOG_FIELDS__(DBG, __VA_ARGS__)
+#define IsaLogDebugEveryN(n, ...)               ISA__LOG_EVERY_N__(DBG, n, __VA_ARGS__)
+#define IsaLogDebugFirstN(n, ...)               ISA__LOG_FIRST_N__(DBG, n, __VA_ARGS__)
+#define IsaLogDebugRateLimited(per_second, ...) ISA__LOG_RATE_LIMITED__(DBG, per_second, __VA_ARGS__)
+#else
+#define IsaLogDebug(...)                        ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogDebugNoModule(...)                ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogDebugFields(...)                  ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogDebugEveryN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogDebugFirstN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogDebugRateLimited(per_second, ...) ISA__LOG_DISABLED__(per_second, __VA_ARGS__)
+#endif
+
+#if ISA_LOG_LEVEL >= ISA_LOG_LEVEL_INF
+#define IsaLogInfo(...)                        ISA__LOG__(INF, __VA_ARGS__)
+#define IsaLogInfoNoModule(...)                ISA__LOG_NO_MODULE__(INF, __VA_ARGS__)
+#define IsaLogInfoFields(...)                  ISA__LOG_FIELDS__(INF, __VA_ARGS__)
+#define IsaLogInfoEveryN(n, ...)               ISA__LOG_EVERY_N__(INF, n, __VA_ARGS__)
+#define IsaLogInfoFirstN(n, ...)               ISA__LOG_FIRST_N__(INF, n, __VA_ARGS__)
+#define IsaLogInfoRateLimited(per_second, ...) ISA__LOG_RATE_LIMITED__(INF, per_second, __VA_ARGS__)
+#else
+#define IsaLogInfo(...)                        ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogInfoNoModule(...)                ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogInfoFields(...)                  ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogInfoEveryN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogInfoFirstN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogInfoRateLimited(per_second, ...) ISA__LOG_DISABLED__(per_second, __VA_ARGS__)
+#endif
+
+#if ISA_LOG_LEVEL >= ISA_LOG_LEVEL_WRN
+#define IsaLogWarning(...)                        ISA__LOG__(WRN, __VA_ARGS__)
+#define IsaLogWarningNoModule(...)                ISA__LOG_NO_MODULE__(WRN, __VA_ARGS__)
+#define IsaLogWarningFields(...)                  ISA__LOG_FIELDS__(WRN, __VA_ARGS__)
+#define IsaLogWarningEveryN(n, ...)               ISA__LOG_EVERY_N__(WRN, n, __VA_ARGS__)
+#define IsaLogWarningFirstN(n, ...)               ISA__LOG_FIRST_N__(WRN, n, __VA_ARGS__)
+#define IsaLogWarningRateLimited(per_second, ...) ISA__LOG_RATE_LIMITED__(WRN, per_second, __VA_ARGS__)
+#else
+#define IsaLogWarning(...)                        ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogWarningNoModule(...)                ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogWarningFields(...)                  ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogWarningEveryN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogWarningFirstN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogWarningRateLimited(per_second, ...) ISA__LOG_DISABLED__(per_second, __VA_ARGS__)
+#endif
+
+#if ISA_LOG_LEVEL >= ISA_LOG_LEVEL_ERR
+#define IsaLogError(...)                        ISA__LOG__(ERR, __VA_ARGS__)
+#define IsaLogErrorNoModule(...)                ISA__LOG_NO_MODULE__(ERR, __VA_ARGS__)
+#define IsaLogErrorFields(...)                  ISA__LOG_FIELDS__(ERR, __VA_ARGS__)
+#define IsaLogErrorEveryN(n, ...)               ISA__LOG_EVERY_N__(ERR, n, __VA_ARGS__)
+#define IsaLogErrorFirstN(n, ...)               ISA__LOG_FIRST_N__(ERR, n, __VA_ARGS__)
+#define IsaLogErrorRateLimited(per_second, ...) ISA__LOG_RATE_LIMITED__(ERR, per_second, __VA_ARGS__)
+#else
+#define IsaLogError(...)                        ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogErrorNoModule(...)                ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogErrorFields(...)                  ISA__LOG_DISABLED__(__VA_ARGS__)
+#define IsaLogErrorEveryN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogErrorFirstN(n, ...)               ISA__LOG_DISABLED__(n, __VA_ARGS__)
+#define IsaLogErrorRateLimited(per_second, ...) ISA__LOG_DISABLED__(per_second, __VA_ARGS__)
+#endif
+
+#if !defined(NDEBUG)
+#define IsaAssert(condition)                                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(!(condition))                                                                                               \
+        {                                                                                                              \
+            ISA__LOG_NO_MODULE__(ERR, "Assertion failed: " ISA_STRINGIFY(condition));                                  \
+            assert(condition);                                                                                         \
+        }                                                                                                              \
+    } while(0)
+#else
+#define IsaAssert(condition) ISA__LOG_DISABLED__(condition)
+#endif // NDEBUG
+
+/* Kept out of line and marked cold so IsaAssertAlways only costs a compare and
+ * a not-taken branch in the caller */
+ISA_COLD ISA_NORETURN void
+Isa__AssertFailed__(const char *Condition, const char *Function, const char *File, int Line)
+{
+    Isa__WriteLogNoModule__("ERR", Function, "Assertion failed: %s (%s:%d)", Condition, File, Line);
+    abort();
+}
+
+/* Like IsaAssert, but also checked in release builds */
+#define IsaAssertAlways(condition)                                                                                     \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if(ISA_UNLIKELY(!(condition)))                                                                                 \
+        {                                                                                                              \
+            Isa__AssertFailed__(ISA_STRINGIFY(condition), __func__, __FILE__, __LINE__);                               \
+        }                                                                                                              \
+    } while(0)
+
+////////////////////////////////////////
+//               MISC                 //
+////////////////////////////////////////
+
+bool
+IsaDoubleEpsilonCompare(const double A, const double B)
+{
+    double GreatestValue = (fabs(A) < fabs(B)) ? fabs(B) : fabs(A);
+    return fabs(A - B) <= (GreatestValue * DBL_EPSILON);
+}
+
+u64
+IsaDoubleSignBit(double F)
+{
+    u64  Mask = 1ULL << 63;
+    u64 *Comp = (u64 *)&F;
+
+    return (*Comp) & Mask;
+}
+
+double
+IsaRadiansFromDegrees(double Degrees)
+{
+    double Radians = 0.01745329251994329577f * Degrees;
+    return Radians;
+}
+
+////////////////////////////////////////
+//               MEMORY               //
+////////////////////////////////////////
+
+/* Blocks smaller than this are always zeroed with memset. Bigger ones are
+ * zeroed with non-temporal stores if they are also bigger than the last-level
+ * cache */
+#if !defined(ISA_MEMZERO_NON_TEMPORAL_MIN)
+#define ISA_MEMZERO_NON_TEMPORAL_MIN IsaMebiByte(1)
+#endif
+
+long get_cache_size(int level);
+
+/**
+ * @brief Size of the biggest cache cpu0 reports, or
+ * ISA_MEMZERO_NON_TEMPORAL_MIN if there is none to read
+ */
+u64
+Isa__LastLevelCacheSize__(void)
+{
+    isa_persist volatile u64 CacheSize = 0;
+
+    u64 Size = IsaAtomicLoad64(&CacheSize);
+    if(!Size)
+    {
+        Size = ISA_MEMZERO_NON_TEMPORAL_MIN;
+        for(int Index = 1; Index <= 8; ++Index)
+        {
+            long LevelSize = get_cache_size(Index);
+            if(LevelSize > 0 && (u64)LevelSize > Size)
+            {
+                Size = (u64)LevelSize;
+            }
+        }
+        IsaAtomicStore64(&CacheSize, Size);
+    }
+
+    return Size;
+}
+
+#if defined(ISA__HAS_SSE2__)
+/**
+ * @brief Zeroes with stores that go around the cache. They don't read the lines
+ * they write first, and they don't evict what the caller has in the cache
+ */
+void
+Isa__MemZeroNonTemporal__(void *Mem, u64 Size)
+{
+    u8 *At   = (u8 *)Mem;
+    u64 Head = IsaMin((u64)(IsaAlignUp((uintptr_t)At, 64) - (uintptr_t)At), Size);
+    memset(At, 0, Head);
+    At += Head;
+    Size -= Head;
+
+    __m128i Zero = _mm_setzero_si128();
+    for(; Size >= 64; Size -= 64, At += 64)
+    {
+        _mm_stream_si128((__m128i *)At, Zero);
+        _mm_stream_si128((__m128i *)(At + 16), Zero);
+        _mm_stream_si128((__m128i *)(At + 32), Zero);
+        _mm_stream_si128((__m128i *)(At + 48), Zero);
+    }
+    _mm_sfence();
+
+    memset(At, 0, Size);
+}
+#endif
+
+void
+IsaMemZero(void *Mem, u64 Size)
+{
+    // NOTE(ingar): memset already picks between wide stores and rep stosb by
+    // size, so only blocks too big to cache are handled differently
+#if defined(ISA__HAS_SSE2__)
+    if(Size >= ISA_MEMZERO_NON_TEMPORAL_MIN && Size >= Isa__LastLevelCacheSize__())
+    {
+        Isa__MemZeroNonTemporal__(Mem, Size);
+        return;
+    }
+#endif
+    memset(Mem, 0, Size);
+}
+
+void /* From https://github.com/BLAKE2/BLAKE2/blob/master/ref/blake2-impl.h */
+IsaMemZeroSecure(void *Mem, u64 Size)
+{
+    static void *(*const volatile memset_v)(void *, int, u64) = &memset;
+    (void)memset_v(Mem, 0, Size);
+}
+
+#define IsaMemZeroStruct(struct)       IsaMemZero(struct, sizeof(*struct))
+#define IsaMemZeroStructSecure(struct) IsaMemZeroSecure(struct, sizeof(*struct))
+
+// TODO(ingar): Change all u64 instances with fixed size to ensure, well...
+// fixed size?
+typedef struct isa_slice
+{
+    u64 Len; /* Not size_t since I want the member size to be constant */
+    u64 ESize;
+    u8 *Mem;
+} isa_slice;
+
+/* A reserved arena claims a large range of address space up front, but only
+ * commits memory as pushes reach it, ISA_ARENA_COMMIT_SIZE at a time. Pointers
+ * into it stay valid as it grows, and it only costs what has been pushed. With
+ * ISA_ARENA_DECOMMIT, clearing it or seeking back hands the memory above the
+ * new position back to the OS. Other arenas are fully committed from the start,
+ * so the extra check on push only costs a compare */
+
+#if !defined(ISA_ARENA_COMMIT_SIZE)
+#define ISA_ARENA_COMMIT_SIZE IsaKibiByte(64) /* Must be a multiple of the page size */
+#endif
+
+#if !defined(ISA_ARENA_LAZY_ZERO_SIZE)
+#define ISA_ARENA_LAZY_ZERO_SIZE IsaMebiByte(1) /* Reserved arenas at least this big drop pages to clear them */
+#endif
+
+#define ISA_ARENA_DECOMMIT      (1U << 0)  /* Give memory back on IsaArenaClear and when seeking back */
+#define ISA_ARENA_HUGE_PAGES    (1U << 1)  /* Back the arena with 2 MiB pages, see below */
+#define ISA_ARENA_HUGE_PAGES_1G (1U << 2)  /* Try 1 GiB pages before 2 MiB ones */
+#define ISA__ARENA_HUGETLB__    (1U << 29) /* Set when the arena got pages from the huge page pool */
+#define ISA_ARENA_CHAINED       (1U << 30) /* Set by IsaArenaCreateChained */
+#define ISA_ARENA_RESERVED      (1U << 31) /* Set by IsaArenaReserve */
+
+void *
+Isa__VmReserve__(u64 Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return VirtualAlloc(NULL, Size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+    Flags |= MAP_NORESERVE;
+#endif
+    void *Mem = mmap(NULL, Size, PROT_NONE, Flags, -1, 0);
+    return (MAP_FAILED == Mem) ? NULL : Mem;
+#endif
+}
+
+bool
+Isa__VmCommit__(void *Mem, u64 Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return NULL != VirtualAlloc(Mem, Size, MEM_COMMIT, PAGE_READWRITE);
+#else
+    return 0 == mprotect(Mem, Size, PROT_READ | PROT_WRITE);
+#endif
+}
+
+void
+Isa__VmDecommit__(void *Mem, u64 Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    VirtualFree(Mem, Size, MEM_DECOMMIT);
+#else
+    madvise(Mem, Size, MADV_DONTNEED);
+    mprotect(Mem, Size, PROT_NONE);
+#endif
+}
+
+/**
+ * @brief Replaces committed pages with zeroed ones the OS hands out when they
+ * are next touched
+ * @return false if Mem or Size is not page-aligned for the OS
+ */
+bool
+Isa__VmZero__(void *Mem, u64 Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return VirtualFree(Mem, Size, MEM_DECOMMIT) && VirtualAlloc(Mem, Size, MEM_COMMIT, PAGE_READWRITE);
+#else
+    return 0 == madvise(Mem, Size, MADV_DONTNEED);
+#endif
+}
+
+void
+Isa__VmRelease__(void *Mem, u64 Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    (void)Size;
+    VirtualFree(Mem, 0, MEM_RELEASE);
+#else
+    munmap(Mem, Size);
+#endif
+}
+
+/* On machines with several NUMA nodes, memory is fastest to reach from the
+ * node it is on. Memory reserved on a node gets its pages from that node when
+ * they are first touched, no matter which thread touches them. It is a
+ * preference rather than a hard binding, so a full node spills over to the
+ * others instead of failing the allocation */
+
+#if !defined(ISA_NUMA_MAX_NODES)
+#define ISA_NUMA_MAX_NODES 64
+#endif
+
+#define ISA_NUMA_ANY_NODE (-1)
+
+#define ISA__MPOL_PREFERRED__ 1 /* From linux/mempolicy.h, so libnuma is not needed */
+
+/**
+ * @return How many NUMA nodes there are, counting up to the highest node number
+ */
+u32
+IsaNumaNodeCount(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    ULONG HighestNode = 0;
+    return GetNumaHighestNodeNumber(&HighestNode) ? IsaMin((u32)HighestNode + 1, (u32)ISA_NUMA_MAX_NODES) : 1;
+#else
+    FILE *File = fopen("/sys/devices/system/node/online", "r");
+    if(!File)
+    {
+        return 1;
+    }
+
+    // NOTE(ingar): The file lists ranges like "0-1,3", so the last number is
+    // the highest node
+    u32 HighestNode = 0;
+    u32 Node;
+    while(1 == fscanf(File, "%u", &Node))
+    {
+        HighestNode = IsaMax(HighestNode, Node);
+        if(EOF == fgetc(File))
+        {
+            break;
+        }
+    }
+    fclose(File);
+
+    return IsaMin(HighestNode + 1, (u32)ISA_NUMA_MAX_NODES);
+#endif
+}
+
+/**
+ * @return The node the calling thread is running on. The thread can be moved
+ * right after, so this is a hint unless the thread is pinned
+ */
+u32
+IsaNumaCurrentNode(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    PROCESSOR_NUMBER Processor;
+    USHORT           Node = 0;
+    GetCurrentProcessorNumberEx(&Processor);
+    GetNumaProcessorNodeEx(&Processor, &Node);
+    return Node;
+#else
+    unsigned int Cpu  = 0;
+    unsigned int Node = 0;
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+    getcpu(&Cpu, &Node); // NOTE(ingar): Goes through the vDSO, unlike the syscall
+#else
+    syscall(SYS_getcpu, &Cpu, &Node, NULL);
+#endif
+    return Node;
+#endif
+}
+
+/**
+ * @brief Makes the pages of a reserved range come from Node
+ * @return false if there is no such node
+ */
+bool
+Isa__VmPreferNode__(void *Mem, u64 Size, int Node)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    // NOTE(ingar): Windows picks the node when the range is reserved
+    (void)Mem;
+    (void)Size;
+    (void)Node;
+    return false;
+#else
+    unsigned long Mask[(ISA_NUMA_MAX_NODES + (8 * sizeof(unsigned long)) - 1) / (8 * sizeof(unsigned long))] = { 0 };
+    Mask[Node / (8 * sizeof(unsigned long))] |= 1UL << (Node % (8 * sizeof(unsigned long)));
+
+    // NOTE(ingar): The kernel reads one bit less than it is told to. Kernels
+    // without NUMA have nothing to bind to, which is fine
+    long Error = syscall(SYS_mbind, Mem, Size, ISA__MPOL_PREFERRED__, Mask, (unsigned long)(8 * sizeof(Mask)) + 1, 0);
+    return 0 == Error || ENOSYS == errno;
+#endif
+}
+
+/**
+ * @brief Reserves address space whose pages come from Node, or from wherever
+ * the OS likes if Node is ISA_NUMA_ANY_NODE
+ */
+void *
+Isa__VmReserveOnNode__(u64 Size, int Node)
+{
+    if(Node < 0)
+    {
+        return Isa__VmReserve__(Size);
+    }
+
+    if(Node >= ISA_NUMA_MAX_NODES)
+    {
+        return NULL;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    return VirtualAllocExNuma(GetCurrentProcess(), NULL, Size, MEM_RESERVE, PAGE_NOACCESS, (DWORD)Node);
+#else
+    void *Mem = Isa__VmReserve__(Size);
+    if(Mem && !Isa__VmPreferNode__(Mem, Size, Node))
+    {
+        Isa__VmRelease__(Mem, Size);
+        return NULL;
+    }
+
+    return Mem;
+#endif
+}
+
+/* Huge pages cut TLB misses for arenas that span gigabytes. An arena asks for
+ * them with ISA_ARENA_HUGE_PAGES, and gets the first of these that works:
+ *
+ * 1. Pages from the huge page pool (MAP_HUGETLB), 1 GiB ones first with
+ *    ISA_ARENA_HUGE_PAGES_1G. The whole reservation is taken from the pool up
+ *    front, so this only works if the pool has been given enough pages.
+ * 2. A reservation aligned to 2 MiB and marked MADV_HUGEPAGE, which the kernel
+ *    backs with transparent huge pages when it can.
+ * 3. Normal pages.
+ *
+ * The arena commits a huge page at a time, so the huge pages are mapped as a
+ * whole. IsaArenaHugePageBytes tells how much of the arena ended up on huge
+ * pages. Windows only gives out large pages committed up front, and only to
+ * processes allowed to lock memory, so arenas there always use normal pages */
+
+#define ISA__HUGE_PAGE_SIZE__    IsaMebiByte(2)
+#define ISA__HUGE_PAGE_SIZE_1G__ IsaGibiByte(1)
+
+/**
+ * @return What the arena commits and decommits at a time
+ */
+u64
+Isa__ArenaCommitSize__(u32 Flags)
+{
+    if(Flags & ISA_ARENA_HUGE_PAGES_1G)
+    {
+        return ISA__HUGE_PAGE_SIZE_1G__;
+    }
+
+    return (Flags & ISA_ARENA_HUGE_PAGES) ? ISA__HUGE_PAGE_SIZE__ : ISA_ARENA_COMMIT_SIZE;
+}
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+void *
+Isa__VmReserveHugetlb__(u64 Size, u64 PageSize, int Node)
+{
+    // NOTE(ingar): No MAP_NORESERVE, so the pool pages are set aside now
+    // rather than missing when they are touched, which would be a SIGBUS
+    int   Log2  = (ISA__HUGE_PAGE_SIZE_1G__ == PageSize) ? 30 : 21;
+    int   Flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (Log2 << MAP_HUGE_SHIFT);
+    void *Mem   = mmap(NULL, Size, PROT_NONE, Flags, -1, 0);
+    if(MAP_FAILED == Mem)
+    {
+        return NULL;
+    }
+
+    if(Node >= 0 && !Isa__VmPreferNode__(Mem, Size, Node))
+    {
+        munmap(Mem, Size);
+        return NULL;
+    }
+
+    return Mem;
+}
+#endif
+
+/**
+ * @brief Reserves address space for a huge page arena, rounding Size up to the
+ * page size it got. Flags are updated to say which pages it got
+ */
+void *
+Isa__VmReserveHuge__(u64 *Size, u32 *Flags, int Node)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    *Flags &= ~(ISA_ARENA_HUGE_PAGES | ISA_ARENA_HUGE_PAGES_1G);
+    *Size = IsaAlignUp(*Size, ISA_ARENA_COMMIT_SIZE);
+    return Isa__VmReserveOnNode__(*Size, Node);
+#else
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if(*Flags & ISA_ARENA_HUGE_PAGES_1G)
+    {
+        u64   HugeSize = IsaAlignUp(*Size, ISA__HUGE_PAGE_SIZE_1G__);
+        void *Pooled   = Isa__VmReserveHugetlb__(HugeSize, ISA__HUGE_PAGE_SIZE_1G__, Node);
+        if(Pooled)
+        {
+            *Size = HugeSize;
+            *Flags |= ISA__ARENA_HUGETLB__;
+            return Pooled;
+        }
+    }
+
+    *Flags = (*Flags & ~ISA_ARENA_HUGE_PAGES_1G) | ISA_ARENA_HUGE_PAGES;
+    *Size  = IsaAlignUp(*Size, ISA__HUGE_PAGE_SIZE__);
+
+    void *Pooled = Isa__VmReserveHugetlb__(*Size, ISA__HUGE_PAGE_SIZE__, Node);
+    if(Pooled)
+    {
+        *Flags |= ISA__ARENA_HUGETLB__;
+        return Pooled;
+    }
+#else
+    *Flags = (*Flags & ~ISA_ARENA_HUGE_PAGES_1G) | ISA_ARENA_HUGE_PAGES;
+    *Size  = IsaAlignUp(*Size, ISA__HUGE_PAGE_SIZE__);
+#endif
+
+    // NOTE(ingar): mmap only aligns to normal pages, so reserve a huge page
+    // extra and give back what is outside the aligned range
+    u8 *Mem = (u8 *)Isa__VmReserveOnNode__(*Size + ISA__HUGE_PAGE_SIZE__, Node);
+    if(!Mem)
+    {
+        return NULL;
+    }
+
+    u8 *Aligned = (u8 *)IsaAlignUp((uintptr_t)Mem, ISA__HUGE_PAGE_SIZE__);
+    u64 Head    = (u64)(Aligned - Mem);
+    if(Head)
+    {
+        munmap(Mem, Head);
+    }
+    munmap(Aligned + *Size, ISA__HUGE_PAGE_SIZE__ - Head);
+
+#if defined(MADV_HUGEPAGE)
+    madvise(Aligned, *Size, MADV_HUGEPAGE);
+#endif
+
+    return Aligned;
+#endif
+}
+
+/**
+ * @brief Reserves ReserveSize bytes of address space for an arena, and commits
+ * the first ISA_ARENA_COMMIT_SIZE bytes, or the first huge page, which hold the
+ * arena itself
+ * @param Flags 0, or any of ISA_ARENA_DECOMMIT, ISA_ARENA_HUGE_PAGES and
+ * ISA_ARENA_HUGE_PAGES_1G
+ * @param Node The NUMA node the arena's memory comes from, or ISA_NUMA_ANY_NODE
+ * @return The arena, to be given back with IsaArenaRelease, or NULL
+ */
+isa_arena *
+IsaArenaReserveOnNode(u64 ReserveSize, u32 Flags, int Node)
+{
+    u8 *Base;
+    if(Flags & (ISA_ARENA_HUGE_PAGES | ISA_ARENA_HUGE_PAGES_1G))
+    {
+        ReserveSize = IsaMax(ReserveSize, (u64)ISA__HUGE_PAGE_SIZE__);
+        Base        = (u8 *)Isa__VmReserveHuge__(&ReserveSize, &Flags, Node);
+    }
+    else
+    {
+        ReserveSize = IsaAlignUp(IsaMax(ReserveSize, (u64)ISA_ARENA_COMMIT_SIZE), ISA_ARENA_COMMIT_SIZE);
+        Base        = (u8 *)Isa__VmReserveOnNode__(ReserveSize, Node);
+    }
+
+    if(!Base)
+    {
+        return NULL;
+    }
+
+    u64 CommitSize = IsaMin(Isa__ArenaCommitSize__(Flags), ReserveSize);
+    if(!Isa__VmCommit__(Base, CommitSize))
+    {
+        Isa__VmRelease__(Base, ReserveSize);
+        return NULL;
+    }
+
+    isa_arena *Arena = (isa_arena *)Base;
+    Arena->Cur       = 0;
+    Arena->Cap       = ReserveSize - sizeof(isa_arena);
+    Arena->Save      = 0;
+    Arena->Committed = CommitSize - sizeof(isa_arena);
+    Arena->Flags     = Flags | ISA_ARENA_RESERVED;
+    Arena->TempDepth = 0;
+    Arena->BasePos   = 0;
+    Arena->Block     = NULL;
+    Arena->Mem       = Base + sizeof(isa_arena);
+#if defined(ISA_ARENA_INSTRUMENT)
+    Arena->Stats = NULL;
+#endif
+
+    return Arena;
+}
+
+isa_arena *
+IsaArenaReserve(u64 ReserveSize, u32 Flags)
+{
+    return IsaArenaReserveOnNode(ReserveSize, Flags, ISA_NUMA_ANY_NODE);
+}
+
+/**
+ * @return How many bytes of a reserved arena are on huge pages right now,
+ * including the ones that hold the arena itself
+ */
+u64
+IsaArenaHugePageBytes(isa_arena *Arena)
+{
+    if(!(Arena->Flags & ISA_ARENA_RESERVED))
+    {
+        return 0;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    return 0;
+#else
+    FILE *File = fopen("/proc/self/smaps", "r");
+    if(!File)
+    {
+        return 0;
+    }
+
+    // NOTE(ingar): Each mapping starts with a line giving its range, followed
+    // by lines of counters in kB
+    uintptr_t Base        = (uintptr_t)Arena;
+    uintptr_t End         = Base + sizeof(isa_arena) + Arena->Cap;
+    bool      InArena     = false;
+    u64       HugeKiBytes = 0;
+    char      Line[256];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        unsigned long long Start, Stop, KiBytes;
+        if(2 == sscanf(Line, "%llx-%llx ", &Start, &Stop))
+        {
+            InArena = (Start < End) && (Stop > Base);
+        }
+        else if(InArena
+                && (1 == sscanf(Line, "AnonHugePages: %llu kB", &KiBytes)
+                    || 1 == sscanf(Line, "Private_Hugetlb: %llu kB", &KiBytes)))
+        {
+            HugeKiBytes += KiBytes;
+        }
+    }
+    fclose(File);
+
+    return IsaMin(HugeKiBytes * 1024, (u64)(sizeof(isa_arena) + Arena->Committed));
+#endif
+}
+
+/**
+ * @brief Commits enough of a reserved arena for its first End bytes
+ * @return false if the arena is not reserved or the OS is out of memory
+ */
+ISA_COLD bool
+Isa__ArenaCommit__(isa_arena *Arena, u64 End)
+{
+    if(!(Arena->Flags & ISA_ARENA_RESERVED))
+    {
+        return false;
+    }
+
+    // NOTE(ingar): The arena sits at the start of its reservation, so commit
+    // boundaries are measured from there rather than from Mem
+    u8 *Base         = (u8 *)Arena;
+    u64 Committed    = sizeof(isa_arena) + Arena->Committed;
+    u64 Reserved     = sizeof(isa_arena) + Arena->Cap;
+    u64 CommitSize   = Isa__ArenaCommitSize__(Arena->Flags);
+    u64 NewCommitted = IsaMin(IsaAlignUp(sizeof(isa_arena) + End, CommitSize), Reserved);
+    if(!Isa__VmCommit__(Base + Committed, NewCommitted - Committed))
+    {
+        return false;
+    }
+
+    Arena->Committed = NewCommitted - sizeof(isa_arena);
+    return true;
+}
+
+/**
+ * @brief Gives back whole commit blocks above Pos if the arena decommits
+ */
+void
+Isa__ArenaDecommit__(isa_arena *Arena, u64 Pos)
+{
+    if((ISA_ARENA_RESERVED | ISA_ARENA_DECOMMIT) != (Arena->Flags & (ISA_ARENA_RESERVED | ISA_ARENA_DECOMMIT)))
+    {
+        return;
+    }
+
+    u8 *Base         = (u8 *)Arena;
+    u64 Committed    = sizeof(isa_arena) + Arena->Committed;
+    u64 NewCommitted = IsaAlignUp(sizeof(isa_arena) + Pos, Isa__ArenaCommitSize__(Arena->Flags));
+    if(NewCommitted < Committed)
+    {
+        Isa__VmDecommit__(Base + NewCommitted, Committed - NewCommitted);
+        Arena->Committed = NewCommitted - sizeof(isa_arena);
+    }
+}
+
+/* A chained arena is a linked list of malloc'ed blocks, for when there are too
+ * many arenas to give each its own reservation. When a push does not fit, the
+ * arena moves on to a new block, so there is no hard limit. Positions count
+ * across blocks without gaps: each block starts at the position the arena had
+ * when it moved on, so the unused end of a block takes up none, and popping
+ * what was pushed always returns to where the arena was. Seeking back to or
+ * past the start of a block gives the block to the calling thread's block
+ * cache, where the next arena that needs one finds it, so arenas that come and
+ * go do not cost a malloc each */
+
+#if !defined(ISA_ARENA_BLOCK_CACHE_SIZE)
+#define ISA_ARENA_BLOCK_CACHE_SIZE 16 /* Blocks each thread keeps for reuse */
+#endif
+
+struct isa__arena_block__
+{
+    isa__arena_block__ *Prev;
+    u64                 Size;      /* Bytes after the header */
+    u64                 BlockSize; /* What the arena asks for when it needs a new block */
+
+    /* Where the arena was in this block when it moved on to the next */
+    u8 *Mem;
+    u64 Cap;
+    u64 Cur;
+    u64 BasePos;
+};
+
+typedef struct isa__arena_block_cache__
+{
+    isa__arena_block__ *First;
+    u32                 Count;
+} isa__arena_block_cache__;
+
+// NOTE(ingar): Like the log buffers, cached blocks are not freed when their
+// thread exits. Call IsaArenaTrimBlockCache before a thread that has used
+// chained arenas exits if that matters
+isa__arena_block_cache__ *
+Isa__GetArenaBlockCache__(void)
+{
+    isa_persist isa_thread_local isa__arena_block_cache__ Cache = { 0 };
+    return &Cache;
+}
+
+/**
+ * @brief Takes a block of at least Size bytes from the cache, or mallocs one.
+ * Cached blocks are only reused for requests at least half their size, so
+ * one big block does not end up serving small arenas
+ */
+isa__arena_block__ *
+Isa__ArenaBlockAlloc__(u64 Size)
+{
+    isa__arena_block_cache__ *Cache = Isa__GetArenaBlockCache__();
+    for(isa__arena_block__ **Link = &Cache->First; *Link; Link = &(*Link)->Prev)
+    {
+        isa__arena_block__ *Block = *Link;
+        if(Block->Size >= Size && (Block->Size / 2) <= Size)
+        {
+            *Link = Block->Prev;
+            --Cache->Count;
+            return Block;
+        }
+    }
+
+    isa__arena_block__ *Block = (isa__arena_block__ *)malloc(sizeof(isa__arena_block__) + Size);
+    if(Block)
+    {
+        Block->Size = Size;
+    }
+
+    return Block;
+}
+
+void
+Isa__ArenaBlockFree__(isa__arena_block__ *Block)
+{
+    isa__arena_block_cache__ *Cache = Isa__GetArenaBlockCache__();
+    if(Cache->Count < ISA_ARENA_BLOCK_CACHE_SIZE)
+    {
+        Block->Prev  = Cache->First;
+        Cache->First = Block;
+        ++Cache->Count;
+    }
+    else
+    {
+        free(Block);
+    }
+}
+
+/**
+ * @brief Frees the blocks the calling thread has cached
+ */
+void
+IsaArenaTrimBlockCache(void)
+{
+    isa__arena_block_cache__ *Cache = Isa__GetArenaBlockCache__();
+    while(Cache->First)
+    {
+        isa__arena_block__ *Block = Cache->First;
+        Cache->First              = Block->Prev;
+        free(Block);
+    }
+    Cache->Count = 0;
+}
+
+/**
+ * @param BlockSize Size of each block. The first one also holds the arena, and
+ * pushes bigger than a block get a block of their own
+ * @return The arena, to be given back with IsaArenaRelease, or NULL
+ */
+isa_arena *
+IsaArenaCreateChained(u64 BlockSize)
+{
+    BlockSize                 = IsaMax(BlockSize, (u64)(2 * sizeof(isa_arena)));
+    isa__arena_block__ *Block = Isa__ArenaBlockAlloc__(BlockSize);
+    if(!Block)
+    {
+        return NULL;
+    }
+
+    Block->Prev      = NULL;
+    Block->BlockSize = BlockSize;
+
+    isa_arena *Arena = (isa_arena *)(Block + 1);
+    Arena->Cur       = 0;
+    Arena->Cap       = Block->Size - sizeof(isa_arena);
+    Arena->Save      = 0;
+    Arena->Committed = Arena->Cap;
+    Arena->Flags     = ISA_ARENA_CHAINED;
+    Arena->TempDepth = 0;
+    Arena->BasePos   = 0;
+    Arena->Block     = Block;
+    Arena->Mem       = (u8 *)(Arena + 1);
+#if defined(ISA_ARENA_INSTRUMENT)
+    Arena->Stats = NULL;
+#endif
+
+    return Arena;
+}
+
+/**
+ * @brief Moves a chained arena on to a new block with room for Size bytes
+ */
+ISA_COLD bool
+Isa__ArenaPushBlock__(isa_arena *Arena, u64 Size)
+{
+    isa__arena_block__ *Current = Arena->Block;
+    isa__arena_block__ *Block   = Isa__ArenaBlockAlloc__(IsaMax(Size, Current->BlockSize));
+    if(!Block)
+    {
+        return false;
+    }
+
+    Current->Mem     = Arena->Mem;
+    Current->Cap     = Arena->Cap;
+    Current->Cur     = Arena->Cur;
+    Current->BasePos = Arena->BasePos;
+    Block->Prev      = Current;
+    Block->BlockSize = Current->BlockSize;
+
+    Arena->BasePos += Arena->Cur;
+    Arena->Cur       = 0;
+    Arena->Cap       = Block->Size;
+    Arena->Committed = Block->Size;
+    Arena->Block     = Block;
+    Arena->Mem       = (u8 *)(Block + 1);
+
+    return true;
+}
+
+/**
+ * @brief Moves a chained arena back to the previous block
+ */
+void
+Isa__ArenaPopBlock__(isa_arena *Arena)
+{
+    isa__arena_block__ *Block = Arena->Block;
+    isa__arena_block__ *Prev  = Block->Prev;
+
+    Arena->Cur       = Prev->Cur;
+    Arena->Cap       = Prev->Cap;
+    Arena->Committed = Prev->Cap;
+    Arena->BasePos   = Prev->BasePos;
+    Arena->Block     = Prev;
+    Arena->Mem       = Prev->Mem;
+
+    Isa__ArenaBlockFree__(Block);
+}
+
+/**
+ * @brief Gives back a reserved or chained arena
+ */
+void
+IsaArenaRelease(isa_arena *Arena)
+{
+    if(!Arena)
+    {
+        return;
+    }
+
+#if defined(ISA_ARENA_INSTRUMENT)
+    IsaArenaUnregister(Arena);
+#endif
+
+    if(Arena->Flags & ISA_ARENA_RESERVED)
+    {
+        Isa__VmRelease__(Arena, sizeof(isa_arena) + Arena->Cap);
+    }
+    else if(Arena->Flags & ISA_ARENA_CHAINED)
+    {
+        while(Arena->Block->Prev)
+        {
+            Isa__ArenaPopBlock__(Arena);
+        }
+
+        // NOTE(ingar): The arena lives in its first block
+        Isa__ArenaBlockFree__(Arena->Block);
+    }
+}
+
+/**
+ * @brief Makes room for Size bytes at Align when a push does not fit in the
+ * committed part of the arena
+ * @return false if the arena can not grow
+ */
+ISA_COLD bool
+Isa__ArenaGrow__(isa_arena *Arena, u64 Size, u64 Align)
+{
+    u64 Address = (u64)(uintptr_t)(Arena->Mem + Arena->Cur);
+    u64 Padding = IsaAlignUp(Address, Align) - Address;
+    u64 Free    = Arena->Cap - Arena->Cur;
+    if((Padding <= Free) && (Size <= (Free - Padding)))
+    {
+        return Isa__ArenaCommit__(Arena, Arena->Cur + Padding + Size);
+    }
+
+    if((Arena->Flags & ISA_ARENA_CHAINED) && (Size <= (UINT64_MAX - Align)))
+    {
+        return Isa__ArenaPushBlock__(Arena, Size + Align - 1);
+    }
+
+    return false;
+}
+
+void
+IsaArenaInit(isa_arena *Arena, void *Mem, u64 Size)
+{
+    Arena->Cur       = 0;
+    Arena->Cap       = Size;
+    Arena->Save      = 0;
+    Arena->Committed = Size;
+    Arena->Flags     = 0;
+    Arena->TempDepth = 0;
+    Arena->BasePos   = 0;
+    Arena->Block     = NULL;
+    Arena->Mem       = (u8 *)Mem;
+#if defined(ISA_ARENA_INSTRUMENT)
+    Arena->Stats = NULL;
+#endif
+}
+
+isa_arena *
+IsaArenaCreateContiguous(void *Mem, u64 Size)
+{
+    IsaAssert(Size >= (sizeof(isa_arena) + 1));
+
+    isa_arena *Arena = (isa_arena *)Mem;
+    Arena->Cap       = Size - sizeof(isa_arena);
+    Arena->Cur       = 0;
+    Arena->Save      = 0;
+    Arena->Committed = Arena->Cap;
+    Arena->Flags     = 0;
+    Arena->TempDepth = 0;
+    Arena->BasePos   = 0;
+    Arena->Block     = NULL;
+    Arena->Mem       = (u8 *)Mem + sizeof(isa_arena);
+#if defined(ISA_ARENA_INSTRUMENT)
+    Arena->Stats = NULL;
+#endif
+
+    return Arena;
+}
+
+isa_arena
+IsaArenaCreate(void *Mem, u64 Size)
+{
+    isa_arena Arena;
+    Arena.Cur       = 0;
+    Arena.Cap       = Size;
+    Arena.Save      = 0;
+    Arena.Committed = Size;
+    Arena.Flags     = 0;
+    Arena.TempDepth = 0;
+    Arena.BasePos   = 0;
+    Arena.Block     = NULL;
+    Arena.Mem       = (u8 *)Mem;
+#if defined(ISA_ARENA_INSTRUMENT)
+    Arena.Stats = NULL;
+#endif
+
+    return Arena;
+}
+
+void
+IsaArenaDestroy(isa_arena **Arena)
+{
+    if(Arena && *Arena)
+    {
+#if defined(ISA_ARENA_INSTRUMENT)
+        IsaArenaUnregister(*Arena);
+#endif
+        *Arena = NULL;
+        Arena  = NULL;
+    }
+}
+
+u64
+IsaArenaGetPos(isa_arena *Arena)
+{
+    u64 Pos = Arena->BasePos + Arena->Cur;
+    return Pos;
+}
+
+void
+IsaArenaSeek(isa_arena *Arena, u64 Pos)
+{
+#if defined(ISA_ARENA_INSTRUMENT)
+    // NOTE(ingar): Pops, clears, temp and scratch scopes and F9 all come
+    // through here, so this is where rewinds are counted
+    if(Arena->Stats)
+    {
+        Isa__ArenaRecordSeek__(Arena, Pos);
+    }
+#endif
+
+    // NOTE(ingar): A block's start is also where the arena stood in the one
+    // before it, so seeking to it gives the block back too
+    while(Arena->Block && Arena->Block->Prev && Pos <= Arena->BasePos)
+    {
+        Isa__ArenaPopBlock__(Arena);
+    }
+
+    Pos -= Arena->BasePos;
+    assert(Pos <= Arena->Cap);
+    if(Pos < Arena->Cur)
+    {
+        Isa__ArenaDecommit__(Arena, Pos);
+    }
+    Arena->Cur = Pos;
+
+#if defined(ISA_ARENA_INSTRUMENT)
+    if(Arena->Stats)
+    {
+        Isa__ArenaSnapshot__(Arena->Stats, Arena);
+    }
+#endif
+}
+
+// NOTE(ingar): F5/F9 share the arena's one Save slot, so they can't be nested.
+// Use temp scopes for that
+u64
+IsaArenaF5(isa_arena *Arena)
+{
+    Arena->Save = IsaArenaGetPos(Arena);
+    return Arena->Save;
+}
+
+u64
+IsaArenaF9(isa_arena *Arena)
+{
+    IsaArenaSeek(Arena, Arena->Save);
+    Arena->Save = 0;
+
+    return IsaArenaGetPos(Arena);
+}
+
+void *
+IsaArenaPush(isa_arena *Arena, u64 Size)
+{
+    if((Size <= (Arena->Committed - Arena->Cur)) || Isa__ArenaGrow__(Arena, Size, 1))
+    {
+        u8 *AllocedMem = Arena->Mem + Arena->Cur;
+        Arena->Cur += Size;
+
+        return (void *)AllocedMem;
+    }
+
+    return NULL;
+}
+
+void *
+IsaArenaPushZero(isa_arena *Arena, u64 Size)
+{
+    void *AllocedMem = IsaArenaPush(Arena, Size);
+    if(AllocedMem)
+    {
+        IsaMemZero(AllocedMem, Size);
+    }
+
+    return AllocedMem;
+}
+
+/**
+ * @brief Pushes Size bytes at an address that is a multiple of Align. It is
+ * the address that is aligned, not the offset, so this works for arenas whose
+ * memory is not aligned itself, like contiguous ones
+ * @param Align A power of two, like ISA_ALIGNOF(type), ISA_CACHE_LINE_SIZE or
+ * ISA_PAGE_SIZE
+ * @note The padding in front of the block is part of the push, so popping
+ * Size bytes does not give it back. Use IsaArenaGetPos and IsaArenaSeek
+ * instead
+ */
+void *
+IsaArenaPushAligned(isa_arena *Arena, u64 Size, u64 Align)
+{
+    IsaAssert(IsaIsPowerOfTwo(Align));
+
+    u64 Address = (u64)(uintptr_t)(Arena->Mem + Arena->Cur);
+    u64 Padding = IsaAlignUp(Address, Align) - Address;
+    u64 Free    = Arena->Committed - Arena->Cur;
+    if((Padding > Free) || (Size > (Free - Padding)))
+    {
+        if(!Isa__ArenaGrow__(Arena, Size, Align))
+        {
+            return NULL;
+        }
+
+        // NOTE(ingar): A chained arena may have moved to a new block
+        Address = (u64)(uintptr_t)(Arena->Mem + Arena->Cur);
+        Padding = IsaAlignUp(Address, Align) - Address;
+    }
+
+    u8 *AllocedMem = Arena->Mem + Arena->Cur + Padding;
+    Arena->Cur += Padding + Size;
+
+    return (void *)AllocedMem;
+}
+
+void *
+IsaArenaPushAlignedZero(isa_arena *Arena, u64 Size, u64 Align)
+{
+    void *AllocedMem = IsaArenaPushAligned(Arena, Size, Align);
+    if(AllocedMem)
+    {
+        IsaMemZero(AllocedMem, Size);
+    }
+
+    return AllocedMem;
+}
+
+void
+IsaArenaPop(isa_arena *Arena, u64 Size)
+{
+    u64 Pos = IsaArenaGetPos(Arena);
+    assert(Pos >= Size);
+    IsaArenaSeek(Arena, Pos - Size);
+}
+
+/* Temp scopes mark a position in an arena and go back to it when they end.
+ * Each scope keeps its own position, so scratch allocations can nest as deep
+ * as needed. Debug builds check that scopes end innermost first */
+typedef struct isa_arena_temp
+{
+    isa_arena *Arena;
+    u64        Pos;
+    u32        Depth; /* Only set in debug builds */
+} isa_arena_temp;
+
+isa_arena_temp
+IsaArenaTempBegin(isa_arena *Arena)
+{
+    isa_arena_temp Temp;
+    Temp.Arena = Arena;
+    Temp.Pos   = IsaArenaGetPos(Arena);
+#if defined(NDEBUG)
+    Temp.Depth = 0;
+#else
+    Temp.Depth = ++Arena->TempDepth;
+#endif
+
+    return Temp;
+}
+
+void
+IsaArenaTempEnd(isa_arena_temp Temp)
+{
+    // NOTE(ingar): A scope without an arena is what IsaScratchBegin gives
+    // when it runs out of scratch arenas, so it has nothing to end
+    if(!Temp.Arena)
+    {
+        return;
+    }
+
+#if !defined(NDEBUG)
+    // NOTE(ingar): Fails if a scope ends while one that began after it is
+    // still open, or if the same scope ends twice
+    IsaAssert(Temp.Depth == Temp.Arena->TempDepth);
+    --Temp.Arena->TempDepth;
+#endif
+    IsaArenaSeek(Temp.Arena, Temp.Pos);
+}
+
+#if defined(__cplusplus)
+/* Ends the scope when it goes out of scope:
+ *     IsaArenaTempScope(Arena);
+ *     ... scratch pushes ...
+ */
+struct isa_arena_temp_scope
+{
+    isa_arena_temp Temp;
+
+    explicit isa_arena_temp_scope(isa_arena *Arena) : Temp(IsaArenaTempBegin(Arena)) {}
+    explicit isa_arena_temp_scope(isa_arena_temp Temp) : Temp(Temp) {} /* E.g. from IsaScratchBegin */
+    ~isa_arena_temp_scope() { IsaArenaTempEnd(Temp); }
+
+    isa_arena_temp_scope(const isa_arena_temp_scope &)            = delete;
+    isa_arena_temp_scope &operator=(const isa_arena_temp_scope &) = delete;
+};
+
+#define IsaArenaTempScope(arena) isa_arena_temp_scope ISA_CONCAT2(IsaArenaTempScope_, __LINE__)(arena)
+#endif // C++
+
+/* Each thread has a few scratch arenas for temporaries, so functions don't
+ * need an arena passed in or a malloc for them. A function that returns its
+ * result in an arena it was given passes that arena as a conflict, and gets a
+ * scratch arena that is not it. With two scratch arenas, a chain of such
+ * functions can alternate between them:
+ *
+ *     isa_arena_temp Scratch = IsaScratchBegin(&Arena, 1);
+ *     ... temporaries in Scratch.Arena, the result in Arena ...
+ *     IsaScratchEnd(Scratch);
+ *
+ * The arenas are reserved the first time a thread asks for one. They don't
+ * decommit, so a thread keeps the most scratch it has used committed */
+
+#if !defined(ISA_SCRATCH_ARENA_COUNT)
+#define ISA_SCRATCH_ARENA_COUNT 2
+#endif
+
+#if !defined(ISA_SCRATCH_ARENA_RESERVE_SIZE)
+#define ISA_SCRATCH_ARENA_RESERVE_SIZE IsaGibiByte(8)
+#endif
+
+#if !defined(ISA_SCRATCH_ARENA_BLOCK_SIZE)
+#define ISA_SCRATCH_ARENA_BLOCK_SIZE IsaKibiByte(64) /* Used if the address space can't be reserved */
+#endif
+
+isa_arena **
+Isa__GetScratchArenas__(void)
+{
+    isa_persist isa_thread_local isa_arena *Arenas[ISA_SCRATCH_ARENA_COUNT] = { 0 };
+    return Arenas;
+}
+
+/**
+ * @brief Opens a temp scope in one of the calling thread's scratch arenas
+ * that is none of the ConflictCount arenas in Conflicts
+ * @return The scope, whose Arena is NULL if there was no scratch arena to give.
+ * Ending such a scope does nothing
+ */
+isa_arena_temp
+IsaScratchBegin(isa_arena **Conflicts, u64 ConflictCount)
+{
+    isa_arena **Arenas = Isa__GetScratchArenas__();
+    for(u32 i = 0; i < ISA_SCRATCH_ARENA_COUNT; ++i)
+    {
+        if(!Arenas[i])
+        {
+            Arenas[i] = IsaArenaReserve(ISA_SCRATCH_ARENA_RESERVE_SIZE, 0);
+            if(!Arenas[i])
+            {
+                Arenas[i] = IsaArenaCreateChained(ISA_SCRATCH_ARENA_BLOCK_SIZE);
+            }
+        }
+
+        bool Conflicting = false;
+        for(u64 j = 0; j < ConflictCount; ++j)
+        {
+            if(Conflicts[j] == Arenas[i])
+            {
+                Conflicting = true;
+                break;
+            }
+        }
 
-// TODO(ingar): Change all u64 instances with fixed size to ensure, well...
-// fixed size?
-typedef struct isa_arena
+        if(Arenas[i] && !Conflicting)
+        {
+            return IsaArenaTempBegin(Arenas[i]);
+        }
+    }
+
+    IsaAssert(!"No scratch arena without a conflict, raise ISA_SCRATCH_ARENA_COUNT");
+    isa_arena_temp Temp = { 0 };
+    return Temp;
+}
+
+void
+IsaScratchEnd(isa_arena_temp Scratch)
 {
-    u64 Cur;
+    IsaArenaTempEnd(Scratch);
+}
+
+/**
+ * @brief Gives back the calling thread's scratch arenas. They are reserved
+ * again if the thread asks for scratch later
+ * @note No scratch scopes may be open
+ */
+void
+IsaScratchThreadRelease(void)
+{
+    isa_arena **Arenas = Isa__GetScratchArenas__();
+    for(u32 i = 0; i < ISA_SCRATCH_ARENA_COUNT; ++i)
+    {
+        IsaArenaRelease(Arenas[i]);
+        Arenas[i] = NULL;
+    }
+}
+
+void
+IsaArenaClear(isa_arena *Arena)
+{
+    IsaArenaSeek(Arena, 0);
+}
+
+/**
+ * @brief Zeroes a reserved arena's committed memory by dropping its pages, so
+ * they come back zeroed when touched instead of being written now
+ */
+bool
+Isa__ArenaDropPages__(isa_arena *Arena)
+{
+    // NOTE(ingar): The arena sits at the start of its reservation, and the end
+    // of what is committed is a multiple of the commit size. Pool pages can
+    // only be dropped whole
+    u8 *Base     = (u8 *)Arena;
+    u64 PageSize = (Arena->Flags & ISA__ARENA_HUGETLB__) ? Isa__ArenaCommitSize__(Arena->Flags) : ISA_PAGE_SIZE;
+    u64 First    = IsaAlignUp(sizeof(isa_arena), PageSize);
+    u64 End      = sizeof(isa_arena) + Arena->Committed;
+    if(First >= End || !Isa__VmZero__(Base + First, End - First))
+    {
+        return false;
+    }
+
+    memset(Arena->Mem, 0, First - sizeof(isa_arena));
+    return true;
+}
+
+void
+IsaArenaClearZero(isa_arena *Arena)
+{
+    // NOTE(ingar): Decommitted memory reads back as zero
+    IsaArenaSeek(Arena, 0);
+
+    bool Dropped = (Arena->Flags & ISA_ARENA_RESERVED) && (Arena->Committed >= ISA_ARENA_LAZY_ZERO_SIZE)
+                   && Isa__ArenaDropPages__(Arena);
+    if(!Dropped)
+    {
+        IsaMemZero(Arena->Mem, Arena->Committed);
+    }
+}
+
+/**
+ * @brief sprintf into the arena, with the conversions described in FORMAT.
+ * Formats straight into the arena's free space, so there is only a second pass
+ * when a reserved arena has to commit more memory for the string
+ * @return The null-terminated string, or NULL if it did not fit
+ */
+char *
+IsaArenaFormatV(isa_arena *Arena, const char *Format, va_list VaArgs)
+{
+    va_list Retry;
+    va_copy(Retry, VaArgs);
+
+    char *String    = (char *)(Arena->Mem + Arena->Cur);
+    u64   Available = Arena->Committed - Arena->Cur;
+    i64   Len       = IsaFormatV(String, Available, Format, VaArgs);
+
+    String = (char *)IsaArenaPush(Arena, (u64)Len + 1);
+    if(String && ((u64)Len >= Available))
+    {
+        IsaFormatV(String, (u64)Len + 1, Format, Retry);
+    }
+    va_end(Retry);
+
+    return String;
+}
+
+char *
+IsaArenaFormat(isa_arena *Arena, const char *Format, ...)
+{
+    va_list VaArgs;
+    va_start(VaArgs, Format);
+    char *String = IsaArenaFormatV(Arena, Format, VaArgs);
+    va_end(VaArgs);
+    return String;
+}
+
+#if defined(ISA_ARENA_INSTRUMENT)
+
+/* With ISA_ARENA_INSTRUMENT defined, the push and format calls below are
+ * replaced by macros that count, for each arena, its peak position, pushes,
+ * failed pushes and how many bytes each call site has pushed. An arena is
+ * registered the first time one of them is called on it, and leaves the
+ * registry when it is released or destroyed. From then on IsaArenaSeek counts
+ * every seek too, as a clear if it goes to 0 and as a pop otherwise, so pops,
+ * clears, temp and scratch scopes ending and IsaArenaF9 all show up.
+ * IsaArenaReport prints every registered arena, which is where to look when
+ * sizing them:
+ *
+ *     IsaArenaReport(stderr);
+ *
+ * Each counted call and seek also copies the arena's position, capacity and
+ * flags into its stats, so the report never reads the arena itself and shows
+ * where it stood as of the last one. An arena whose memory goes away without
+ * IsaArenaRelease or IsaArenaDestroy, like one from IsaArenaCreate on the
+ * stack or from IsaArenaCreateContiguous in memory the caller frees, should be
+ * passed to IsaArenaUnregister first. Otherwise it stays in the report and its
+ * stats are never freed.
+ *
+ * The stats hang off the arena, so a copy of a registered arena made by value
+ * shares them and is counted as the original. Only the original unregisters
+ * them, and the copy must not be used after that.
+ *
+ * Counting is done by the thread using the arena, without locks, so numbers
+ * are only exact for arenas that are not in use during the report. Arena
+ * calls made from within isa.h itself are not counted, and the peak is only
+ * sampled on counted calls */
+
+#if !defined(ISA_ARENA_REPORT_SITES)
+#define ISA_ARENA_REPORT_SITES 10 /* Call sites IsaArenaReport lists for each arena */
+#endif
+
+typedef struct isa_arena_site_stats
+{
+    const char *File;
+    u64         Line;
+    u64         Pushes;
+    u64         Failed;
+    u64         Bytes;
+} isa_arena_site_stats;
+
+struct isa_arena_stats
+{
+    isa_arena_stats *Next;
+    isa_arena_stats *Prev;
+    const isa_arena *Arena; /* Only compared and printed, since the arena may be gone */
+
+    u64 Pos; /* Copied from the arena on every counted call */
     u64 Cap;
-    u64 Save; /* Makes it easier to use the arena as a stack */
-    u8 *Mem;  /* If it's last, the arena's memory can be contiguous with the struct
-                 itself */
-} isa_arena;
+    u32 Flags;
+
+    u64 Peak;
+    u64 Pushes;
+    u64 Failed;
+    u64 Pops;
+    u64 Clears;
+    u64 Bytes;
+
+    isa_arena_site_stats *Sites;
+    u32                   SiteCount;
+    u32                   SiteCap;
+    u32                   LastSite; /* Most pushes come from the same place as the last one */
+};
+
+typedef struct isa__arena_registry__
+{
+    isa_mutex        Lock;
+    isa_arena_stats *First;
+} isa__arena_registry__;
 
-typedef struct isa_slice
+isa__arena_registry__ *
+Isa__GetArenaRegistry__(void)
 {
-    u64 Len; /* Not size_t since I want the member size to be constant */
-    u64 ESize;
-    u8 *Mem;
-} isa_slice;
+    isa_persist isa__arena_registry__ Registry = { ISA_MUTEX_INIT, NULL };
+    return &Registry;
+}
+
+/**
+ * @return The arena's stats, registering it if this is the first time it is
+ * seen. NULL if there was no memory for them
+ */
+isa_arena_stats *
+Isa__ArenaStats__(isa_arena *Arena)
+{
+    if(ISA_LIKELY(NULL != Arena->Stats))
+    {
+        return Arena->Stats;
+    }
 
+    isa_arena_stats *Stats = (isa_arena_stats *)calloc(1, sizeof(isa_arena_stats));
+    if(!Stats)
+    {
+        return NULL;
+    }
+    Stats->Arena = Arena;
+
+    isa__arena_registry__ *Registry = Isa__GetArenaRegistry__();
+    IsaMutexLock(&Registry->Lock);
+    Stats->Next = Registry->First;
+    if(Registry->First)
+    {
+        Registry->First->Prev = Stats;
+    }
+    Registry->First = Stats;
+    IsaMutexUnlock(&Registry->Lock);
+
+    Arena->Stats = Stats;
+    return Stats;
+}
+
+/**
+ * @brief Removes the arena from the registry and frees its stats. Called by
+ * IsaArenaRelease and IsaArenaDestroy, and must be called on other arenas
+ * before their memory goes away. Does nothing for arenas that are not
+ * registered, or for a copy of one
+ */
 void
-IsaArenaInit(isa_arena *Arena, void *Mem, u64 Size)
+IsaArenaUnregister(isa_arena *Arena)
 {
-    Arena->Cur  = 0;
-    Arena->Cap  = Size;
-    Arena->Save = 0;
-    Arena->Mem  = (u8 *)Mem;
+    isa_arena_stats *Stats = Arena->Stats;
+    if(!Stats)
+    {
+        return;
+    }
+    Arena->Stats = NULL;
+
+    // NOTE(ingar): The stats are looked up before they are touched, since a
+    // copy of the arena may already have seen the original unregister them
+    isa__arena_registry__ *Registry = Isa__GetArenaRegistry__();
+    IsaMutexLock(&Registry->Lock);
+    isa_arena_stats *Found = Registry->First;
+    while(Found && (Found != Stats || Found->Arena != Arena))
+    {
+        Found = Found->Next;
+    }
+
+    if(Found)
+    {
+        if(Stats->Prev)
+        {
+            Stats->Prev->Next = Stats->Next;
+        }
+        else
+        {
+            Registry->First = Stats->Next;
+        }
+
+        if(Stats->Next)
+        {
+            Stats->Next->Prev = Stats->Prev;
+        }
+    }
+    IsaMutexUnlock(&Registry->Lock);
+
+    if(Found)
+    {
+        free(Stats->Sites);
+        free(Stats);
+    }
 }
 
-isa_arena *
-IsaArenaCreateContiguous(void *Mem, u64 Size)
+/**
+ * @return The stats for a call site, which is added if it is new, or NULL if
+ * there was no memory for it
+ */
+isa_arena_site_stats *
+Isa__ArenaSite__(isa_arena_stats *Stats, const char *File, int Line)
 {
-    IsaAssert(Size >= (sizeof(isa_arena) + 1));
+    // NOTE(ingar): __FILE__ in a header is a different string in each file
+    // that includes it, so the names are compared too
+    for(u32 i = 0; i < Stats->SiteCount; ++i)
+    {
+        u32                   Index = (Stats->LastSite + i) % Stats->SiteCount;
+        isa_arena_site_stats *Site  = &Stats->Sites[Index];
+        if(Site->Line == (u64)Line && (Site->File == File || 0 == strcmp(Site->File, File)))
+        {
+            Stats->LastSite = Index;
+            return Site;
+        }
+    }
 
-    isa_arena *Arena = (isa_arena *)Mem;
-    Arena->Cap       = Size - sizeof(isa_arena);
+    if(Stats->SiteCount == Stats->SiteCap)
+    {
+        u32   NewCap = Stats->SiteCap ? (2 * Stats->SiteCap) : 16;
+        void *Sites  = realloc(Stats->Sites, NewCap * sizeof(isa_arena_site_stats));
+        if(!Sites)
+        {
+            return NULL;
+        }
+
+        Stats->Sites   = (isa_arena_site_stats *)Sites;
+        Stats->SiteCap = NewCap;
+    }
+
+    isa_arena_site_stats *Site = &Stats->Sites[Stats->SiteCount];
+    memset(Site, 0, sizeof(isa_arena_site_stats));
+    Site->File      = File;
+    Site->Line      = (u64)Line;
+    Stats->LastSite = Stats->SiteCount++;
+
+    return Site;
+}
+
+/**
+ * @brief Copies what the report shows out of the arena and samples the peak
+ */
+void
+Isa__ArenaSnapshot__(isa_arena_stats *Stats, isa_arena *Arena)
+{
+    Stats->Pos   = IsaArenaGetPos(Arena);
+    Stats->Cap   = Arena->Cap;
+    Stats->Flags = Arena->Flags;
+    Stats->Peak  = IsaMax(Stats->Peak, Stats->Pos);
+}
+
+void
+Isa__ArenaRecordPush__(isa_arena *Arena, u64 Size, void *Mem, const char *File, int Line)
+{
+    isa_arena_stats *Stats = Isa__ArenaStats__(Arena);
+    if(!Stats)
+    {
+        return;
+    }
+
+    Isa__ArenaSnapshot__(Stats, Arena);
+
+    isa_arena_site_stats *Site = Isa__ArenaSite__(Stats, File, Line);
+    ++Stats->Pushes;
+    if(Site)
+    {
+        ++Site->Pushes;
+    }
+
+    if(Mem)
+    {
+        Stats->Bytes += Size;
+        if(Site)
+        {
+            Site->Bytes += Size;
+        }
+    }
+    else
+    {
+        ++Stats->Failed;
+        if(Site)
+        {
+            ++Site->Failed;
+        }
+    }
+}
+
+/**
+ * @brief Samples the peak before a registered arena goes back to Pos, and
+ * counts it as a clear if Pos is 0 and as a pop otherwise
+ */
+void
+Isa__ArenaRecordSeek__(isa_arena *Arena, u64 Pos)
+{
+    isa_arena_stats *Stats = Arena->Stats;
+    Isa__ArenaSnapshot__(Stats, Arena);
+    ++*((0 == Pos) ? &Stats->Clears : &Stats->Pops);
+}
+
+void *
+Isa__ArenaPushTrace__(isa_arena *Arena, u64 Size, const char *File, int Line)
+{
+    void *Mem = IsaArenaPush(Arena, Size);
+    Isa__ArenaRecordPush__(Arena, Size, Mem, File, Line);
+    return Mem;
+}
+
+void *
+Isa__ArenaPushZeroTrace__(isa_arena *Arena, u64 Size, const char *File, int Line)
+{
+    void *Mem = IsaArenaPushZero(Arena, Size);
+    Isa__ArenaRecordPush__(Arena, Size, Mem, File, Line);
+    return Mem;
+}
+
+void *
+Isa__ArenaPushAlignedTrace__(isa_arena *Arena, u64 Size, u64 Align, const char *File, int Line)
+{
+    void *Mem = IsaArenaPushAligned(Arena, Size, Align);
+    Isa__ArenaRecordPush__(Arena, Size, Mem, File, Line);
+    return Mem;
+}
+
+void *
+Isa__ArenaPushAlignedZeroTrace__(isa_arena *Arena, u64 Size, u64 Align, const char *File, int Line)
+{
+    void *Mem = IsaArenaPushAlignedZero(Arena, Size, Align);
+    Isa__ArenaRecordPush__(Arena, Size, Mem, File, Line);
+    return Mem;
+}
+
+char *
+Isa__ArenaFormatTrace__(const char *File, int Line, isa_arena *Arena, const char *Format, ...)
+{
+    va_list VaArgs;
+    va_start(VaArgs, Format);
+    char *String = IsaArenaFormatV(Arena, Format, VaArgs);
+    va_end(VaArgs);
+
+    Isa__ArenaRecordPush__(Arena, String ? (strlen(String) + 1) : 0, String, File, Line);
+    return String;
+}
+
+/**
+ * @return The arena's stats, or NULL if no counted call has been made on it
+ */
+isa_arena_stats *
+IsaArenaGetStats(isa_arena *Arena)
+{
+    return Arena->Stats;
+}
+
+int
+Isa__CompareSitesByBytes__(const void *A, const void *B)
+{
+    u64 BytesA = ((const isa_arena_site_stats *)A)->Bytes;
+    u64 BytesB = ((const isa_arena_site_stats *)B)->Bytes;
+    return (BytesA < BytesB) - (BytesA > BytesB);
+}
+
+/**
+ * @brief Prints every registered arena, with the ISA_ARENA_REPORT_SITES call
+ * sites that pushed the most bytes to it
+ */
+void
+IsaArenaReport(FILE *Out)
+{
+    isa__arena_registry__ *Registry = Isa__GetArenaRegistry__();
+    IsaMutexLock(&Registry->Lock);
+
+    u64 ArenaCount = 0;
+    for(isa_arena_stats *Stats = Registry->First; Stats; Stats = Stats->Next, ++ArenaCount)
+    {
+        if(Stats->Flags & ISA_ARENA_CHAINED)
+        {
+            // NOTE(ingar): Chained arenas grow as needed, so there is no capacity
+            // to compare against
+            fprintf(Out, "Arena %p (chained): %llu bytes used, peak %llu\n", (const void *)Stats->Arena,
+                    (unsigned long long)Stats->Pos, (unsigned long long)Stats->Peak);
+        }
+        else
+        {
+            fprintf(Out, "Arena %p: %llu of %llu bytes used, peak %llu (%.1f%%)\n", (const void *)Stats->Arena,
+                    (unsigned long long)Stats->Pos, (unsigned long long)Stats->Cap, (unsigned long long)Stats->Peak,
+                    Stats->Cap ? (100.0 * (f64)Stats->Peak / (f64)Stats->Cap) : 0.0);
+        }
+        fprintf(Out, "    %llu pushes (%llu failed) of %llu bytes, %llu pops, %llu clears\n",
+                (unsigned long long)Stats->Pushes, (unsigned long long)Stats->Failed,
+                (unsigned long long)Stats->Bytes, (unsigned long long)Stats->Pops, (unsigned long long)Stats->Clears);
+
+        isa_arena_site_stats *Sites = (isa_arena_site_stats *)malloc(Stats->SiteCount * sizeof(isa_arena_site_stats)
+                                                                     + 1);
+        if(!Sites)
+        {
+            continue;
+        }
+
+        memcpy(Sites, Stats->Sites, Stats->SiteCount * sizeof(isa_arena_site_stats));
+        qsort(Sites, Stats->SiteCount, sizeof(isa_arena_site_stats), Isa__CompareSitesByBytes__);
+        for(u32 i = 0; i < IsaMin(Stats->SiteCount, (u32)ISA_ARENA_REPORT_SITES); ++i)
+        {
+            fprintf(Out, "    %12llu bytes in %8llu pushes (%llu failed) at %s:%llu\n",
+                    (unsigned long long)Sites[i].Bytes, (unsigned long long)Sites[i].Pushes,
+                    (unsigned long long)Sites[i].Failed, Sites[i].File, (unsigned long long)Sites[i].Line);
+        }
+        free(Sites);
+    }
+
+    fprintf(Out, "%llu arenas registered\n", (unsigned long long)ArenaCount);
+    IsaMutexUnlock(&Registry->Lock);
+}
+
+#define IsaArenaPush(arena, size)     Isa__ArenaPushTrace__(arena, size, __FILE__, __LINE__)
+#define IsaArenaPushZero(arena, size) Isa__ArenaPushZeroTrace__(arena, size, __FILE__, __LINE__)
+#define IsaArenaPushAligned(arena, size, align)                                                                        \
+    Isa__ArenaPushAlignedTrace__(arena, size, align, __FILE__, __LINE__)
+#define IsaArenaPushAlignedZero(arena, size, align)                                                                    \
+    Isa__ArenaPushAlignedZeroTrace__(arena, size, align, __FILE__, __LINE__)
+#define IsaArenaFormat(arena, ...)    Isa__ArenaFormatTrace__(__FILE__, __LINE__, arena, __VA_ARGS__)
+
+#else
+
+#define IsaArenaUnregister(arena) ((void)(arena))
+
+#endif // ISA_ARENA_INSTRUMENT
+
+/* An atomic arena can be pushed to from many threads at once. Each thread
+ * claims a sub-block of the arena with one atomic add on the shared cursor, and
+ * then bumps through it on its own, so the cursor's cache line is only touched
+ * once per sub-block. Pushes too big to share a sub-block go straight to the
+ * cursor. What is left of a sub-block when a thread moves on is not reused.
+ *
+ * Resetting hands every push back at once, and is only allowed while the
+ * arena is quiescent: no thread may be pushing, and every thread that pushed
+ * must be synchronized with, e.g. by joining it or waiting on a barrier. The
+ * reset gives the arena a new epoch, which tells the threads that their
+ * sub-blocks are gone. Epochs are unique across arenas, so a new arena that
+ * lands where an old one was does not inherit its sub-blocks */
+
+#if !defined(ISA_ATOMIC_ARENA_BLOCK_SIZE)
+#define ISA_ATOMIC_ARENA_BLOCK_SIZE IsaKibiByte(64) /* Sub-block size for arenas that don't pick their own */
+#endif
+
+#if !defined(ISA_ATOMIC_ARENA_THREAD_SLOTS)
+#define ISA_ATOMIC_ARENA_THREAD_SLOTS 4 /* Atomic arenas each thread can hold a sub-block in at once */
+#endif
+
+typedef struct isa_atomic_arena
+{
+    volatile u64 Cur; /* Alone on its cache line, since it is what the threads contend on */
+    u8           Pad__[ISA_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64 Epoch;
+    u64          Cap;
+    u64          BlockSize;
+    u64          MapSize; /* 0 if the memory is the caller's */
+    u8          *Mem;
+} isa_atomic_arena;
+
+typedef struct isa__atomic_arena_slot__
+{
+    isa_atomic_arena *Arena;
+    u64               Epoch;
+    u64               Cur;
+    u64               End;
+} isa__atomic_arena_slot__;
+
+typedef struct isa__atomic_arena_slots__
+{
+    isa__atomic_arena_slot__ Slots[ISA_ATOMIC_ARENA_THREAD_SLOTS];
+    u32                      Next; /* The slot to take over when there is none for an arena */
+} isa__atomic_arena_slots__;
+
+isa__atomic_arena_slots__ *
+Isa__GetAtomicArenaSlots__(void)
+{
+    isa_persist isa_thread_local isa__atomic_arena_slots__ Slots = { 0 };
+    return &Slots;
+}
+
+u64
+Isa__NextAtomicArenaEpoch__(void)
+{
+    isa_persist volatile u64 Epoch = 0;
+    return IsaAtomicAdd64(&Epoch, 1) + 1;
+}
+
+/**
+ * @brief Sets up an atomic arena in memory the caller owns
+ * @param BlockSize Bytes each thread claims at a time, or 0 for
+ * ISA_ATOMIC_ARENA_BLOCK_SIZE
+ */
+void
+IsaAtomicArenaInit(isa_atomic_arena *Arena, void *Mem, u64 Size, u64 BlockSize)
+{
     Arena->Cur       = 0;
-    Arena->Save      = 0;
-    Arena->Mem       = (u8 *)Mem + sizeof(isa_arena);
+    Arena->Epoch     = Isa__NextAtomicArenaEpoch__();
+    Arena->Cap       = Size;
+    Arena->BlockSize = BlockSize ? BlockSize : ISA_ATOMIC_ARENA_BLOCK_SIZE;
+    Arena->MapSize   = 0;
+
+    // NOTE(ingar): Keeps one thread from claiming all of a small arena
+    Arena->BlockSize = IsaMin(Arena->BlockSize, IsaMax(Size / 8, (u64)ISA_CACHE_LINE_SIZE));
+    Arena->Mem       = (u8 *)Mem;
+}
+
+/**
+ * @brief Maps Size bytes for an atomic arena. The memory is committed up
+ * front, since threads can't take turns committing it, but the OS only backs
+ * the pages pushes touch
+ * @param BlockSize Bytes each thread claims at a time, or 0 for
+ * ISA_ATOMIC_ARENA_BLOCK_SIZE
+ * @param Node The NUMA node the arena's memory comes from, or ISA_NUMA_ANY_NODE
+ * @return The arena, to be given back with IsaAtomicArenaRelease, or NULL
+ */
+isa_atomic_arena *
+IsaAtomicArenaCreateOnNode(u64 Size, u64 BlockSize, int Node)
+{
+    u64 HeaderSize = IsaAlignUp(sizeof(isa_atomic_arena), ISA_CACHE_LINE_SIZE);
+    u64 MapSize    = IsaAlignUp(HeaderSize + Size, ISA_PAGE_SIZE);
+
+    u8 *Base = (u8 *)Isa__VmReserveOnNode__(MapSize, Node);
+    if(!Base)
+    {
+        return NULL;
+    }
+
+    if(!Isa__VmCommit__(Base, MapSize))
+    {
+        Isa__VmRelease__(Base, MapSize);
+        return NULL;
+    }
+
+    isa_atomic_arena *Arena = (isa_atomic_arena *)Base;
+    IsaAtomicArenaInit(Arena, Base + HeaderSize, MapSize - HeaderSize, BlockSize);
+    Arena->MapSize = MapSize;
 
     return Arena;
 }
 
-isa_arena
-IsaArenaCreate(void *Mem, u64 Size)
+isa_atomic_arena *
+IsaAtomicArenaCreate(u64 Size, u64 BlockSize)
 {
-    isa_arena Arena;
-    Arena.Cur  = 0;
-    Arena.Cap  = Size;
-    Arena.Save = 0;
-    Arena.Mem  = (u8 *)Mem;
-
-    return Arena;
+    return IsaAtomicArenaCreateOnNode(Size, BlockSize, ISA_NUMA_ANY_NODE);
 }
 
 void
-IsaArenaDestroy(isa_arena **Arena)
+IsaAtomicArenaRelease(isa_atomic_arena *Arena)
 {
-    if(Arena && *Arena)
+    if(Arena && Arena->MapSize)
     {
-        *Arena = NULL;
-        Arena  = NULL;
+        Isa__VmRelease__(Arena, Arena->MapSize);
     }
 }
 
-u64
-IsaArenaF5(isa_arena *Arena)
+/**
+ * @brief Finds the calling thread's sub-block in the arena, or takes over a
+ * slot for it, dropping whatever sub-block the slot held
+ */
+isa__atomic_arena_slot__ *
+Isa__AtomicArenaSlot__(isa_atomic_arena *Arena)
 {
-    Arena->Save = Arena->Cur;
-    return Arena->Save;
+    isa__atomic_arena_slots__ *Slots = Isa__GetAtomicArenaSlots__();
+    u64                        Epoch = IsaAtomicLoad64(&Arena->Epoch);
+    for(u32 i = 0; i < ISA_ATOMIC_ARENA_THREAD_SLOTS; ++i)
+    {
+        isa__atomic_arena_slot__ *Slot = &Slots->Slots[i];
+        if(Slot->Arena == Arena && Slot->Epoch == Epoch)
+        {
+            return Slot;
+        }
+    }
+
+    isa__atomic_arena_slot__ *Slot = &Slots->Slots[Slots->Next];
+    Slots->Next                    = (Slots->Next + 1) % ISA_ATOMIC_ARENA_THREAD_SLOTS;
+    Slot->Arena                    = Arena;
+    Slot->Epoch                    = Epoch;
+    Slot->Cur                      = 0;
+    Slot->End                      = 0;
+
+    return Slot;
 }
 
-u64
-IsaArenaF9(isa_arena *Arena)
+/**
+ * @brief Claims a new sub-block for the slot, or room for just this push if it
+ * is bigger than a quarter of a sub-block
+ */
+ISA_COLD void *
+Isa__AtomicArenaPushSlow__(isa_atomic_arena *Arena, isa__atomic_arena_slot__ *Slot, u64 Size, u64 Align)
 {
-    Arena->Cur  = Arena->Save;
-    Arena->Save = 0;
+    if(Size > (UINT64_MAX - Align))
+    {
+        return NULL;
+    }
+
+    // NOTE(ingar): Claims past the end still move the cursor, so every claim
+    // after them fails too. It can't realistically wrap. A claim that crosses
+    // the end is still the claimer's up to it
+    u64 Need = Size + Align - 1;
+    if(Need > (Arena->BlockSize / 4))
+    {
+        u64 Start = IsaAtomicAddRelaxed64(&Arena->Cur, Need);
+        if((Start >= Arena->Cap) || (Need > (Arena->Cap - Start)))
+        {
+            return NULL;
+        }
 
-    return Arena->Cur;
+        return (void *)IsaAlignUp((uintptr_t)(Arena->Mem + Start), Align);
+    }
+
+    u64 Start = IsaAtomicAddRelaxed64(&Arena->Cur, Arena->BlockSize);
+    if(Start >= Arena->Cap)
+    {
+        return NULL;
+    }
+
+    Slot->Cur = Start;
+    Slot->End = Start + IsaMin(Arena->BlockSize, Arena->Cap - Start);
+
+    u64 At = (u64)(IsaAlignUp((uintptr_t)(Arena->Mem + Slot->Cur), Align) - (uintptr_t)Arena->Mem);
+    if((At > Slot->End) || (Size > (Slot->End - At)))
+    {
+        return NULL;
+    }
+
+    Slot->Cur = At + Size;
+    return Arena->Mem + At;
 }
 
-// TODO(ingar): Create aligning pushes
+/**
+ * @brief Pushes Size bytes aligned to Align, which must be a power of two.
+ * Safe to call from any number of threads at once
+ * @return The memory, or NULL if the arena is full
+ */
 void *
-IsaArenaPush(isa_arena *Arena, u64 Size)
+IsaAtomicArenaPushAligned(isa_atomic_arena *Arena, u64 Size, u64 Align)
 {
-    if((Arena->Cur + Size) < Arena->Cap)
-    {
-        u8 *AllocedMem = Arena->Mem + Arena->Cur;
-        Arena->Cur += Size;
+    IsaAssert(IsaIsPowerOfTwo(Align));
 
-        return (void *)AllocedMem;
+    isa__atomic_arena_slot__ *Slot = Isa__AtomicArenaSlot__(Arena);
+
+    u64 At = (u64)(IsaAlignUp((uintptr_t)(Arena->Mem + Slot->Cur), Align) - (uintptr_t)Arena->Mem);
+    if((At <= Slot->End) && (Size <= (Slot->End - At)))
+    {
+        Slot->Cur = At + Size;
+        return Arena->Mem + At;
     }
 
-    return NULL;
+    return Isa__AtomicArenaPushSlow__(Arena, Slot, Size, Align);
 }
 
 void *
-IsaArenaPushZero(isa_arena *Arena, u64 Size)
+IsaAtomicArenaPush(isa_atomic_arena *Arena, u64 Size)
 {
-    if((Arena->Cur + Size) < Arena->Cap)
-    {
-        u8 *AllocedMem = Arena->Mem + Arena->Cur;
-        Arena->Cur += Size;
-        IsaMemZero(AllocedMem, Size);
+    return IsaAtomicArenaPushAligned(Arena, Size, 1);
+}
 
-        return (void *)AllocedMem;
+void *
+IsaAtomicArenaPushAlignedZero(isa_atomic_arena *Arena, u64 Size, u64 Align)
+{
+    void *Mem = IsaAtomicArenaPushAligned(Arena, Size, Align);
+    if(Mem)
+    {
+        IsaMemZero(Mem, Size);
     }
 
-    return NULL;
+    return Mem;
 }
 
+/**
+ * @brief Hands back everything pushed to the arena
+ * @note The arena must be quiescent, see above
+ */
 void
-IsaArenaPop(isa_arena *Arena, u64 Size)
+IsaAtomicArenaReset(isa_atomic_arena *Arena)
 {
-    assert(Arena->Cur >= Size);
-    Arena->Cur -= Size;
+    IsaAtomicStore64(&Arena->Cur, 0);
+    IsaAtomicStore64(&Arena->Epoch, Isa__NextAtomicArenaEpoch__());
 }
 
+/**
+ * @return Bytes claimed so far, including what is left of the threads'
+ * sub-blocks
+ */
 u64
-IsaArenaGetPos(isa_arena *Arena)
+IsaAtomicArenaGetUsed(isa_atomic_arena *Arena)
 {
-    u64 Pos = Arena->Cur;
-    return Pos;
+    return IsaMin(IsaAtomicLoad64(&Arena->Cur), Arena->Cap);
 }
 
-void
-IsaArenaSeek(isa_arena *Arena, u64 Pos)
+#define IsaAtomicPushArray(arena, type, count)                                                                         \
+    (type *)IsaAtomicArenaPushAligned(arena, sizeof(type) * (count), ISA_ALIGNOF(type))
+#define IsaAtomicPushArrayZero(arena, type, count)                                                                     \
+    (type *)IsaAtomicArenaPushAlignedZero(arena, sizeof(type) * (count), ISA_ALIGNOF(type))
+#define IsaAtomicPushStruct(arena, type)     IsaAtomicPushArray(arena, type, 1)
+#define IsaAtomicPushStructZero(arena, type) IsaAtomicPushArrayZero(arena, type, 1)
+
+/* One atomic arena per NUMA node, so threads can push to the arena on the node
+ * they run on and keep their allocations node-local:
+ *
+ *     isa_atomic_arena *Arena = IsaNumaArenasGet(&Arenas);
+ *
+ * A thread that is not pinned can be moved to another node at any time, which
+ * only costs it remote accesses to what it already pushed */
+
+typedef struct isa_numa_arenas
 {
-    assert(0 <= Pos && Pos <= Arena->Cap);
-    Arena->Cur = Pos;
+    u32               NodeCount;
+    isa_atomic_arena *Arenas[ISA_NUMA_MAX_NODES];
+} isa_numa_arenas;
+
+/**
+ * @brief Creates an atomic arena of SizePerNode bytes on each node. Nodes that
+ * are offline get an arena that is not bound to any node
+ * @return false if an arena could not be mapped
+ */
+bool
+IsaNumaArenasCreate(isa_numa_arenas *Set, u64 SizePerNode, u64 BlockSize)
+{
+    Set->NodeCount = IsaNumaNodeCount();
+    for(u32 Node = 0; Node < Set->NodeCount; ++Node)
+    {
+        Set->Arenas[Node] = IsaAtomicArenaCreateOnNode(SizePerNode, BlockSize, (int)Node);
+        if(!Set->Arenas[Node])
+        {
+            Set->Arenas[Node] = IsaAtomicArenaCreate(SizePerNode, BlockSize);
+        }
+
+        if(!Set->Arenas[Node])
+        {
+            for(u32 i = 0; i < Node; ++i)
+            {
+                IsaAtomicArenaRelease(Set->Arenas[i]);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @return The arena on the node the calling thread runs on
+ */
+isa_atomic_arena *
+IsaNumaArenasGet(isa_numa_arenas *Set)
+{
+    u32 Node = IsaNumaCurrentNode();
+    return Set->Arenas[(Node < Set->NodeCount) ? Node : 0];
 }
 
+/**
+ * @note Every arena must be quiescent, like for IsaAtomicArenaReset
+ */
 void
-IsaArenaClear(isa_arena *Arena)
+IsaNumaArenasReset(isa_numa_arenas *Set)
 {
-    Arena->Cur = 0;
+    for(u32 Node = 0; Node < Set->NodeCount; ++Node)
+    {
+        IsaAtomicArenaReset(Set->Arenas[Node]);
+    }
 }
 
 void
-IsaArenaClearZero(isa_arena *Arena)
+IsaNumaArenasRelease(isa_numa_arenas *Set)
 {
-    IsaMemZero(Arena->Mem, Arena->Cap);
-    Arena->Cur = 0;
+    for(u32 Node = 0; Node < Set->NodeCount; ++Node)
+    {
+        IsaAtomicArenaRelease(Set->Arenas[Node]);
+        Set->Arenas[Node] = NULL;
+    }
+    Set->NodeCount = 0;
 }
 
 void
@@ -550,11 +7164,21 @@ IsaArrayShift(void *Mem, u64 From, u64 To, u64 Count, u64 ElementSize)
 
 #define IsaArrayDeleteAndShift(mem, i, count, esize) IsaArrayShift(mem, (i + 1), i, count, esize)
 
-#define IsaPushArray(arena, type, count)     (type *)IsaArenaPush(arena, sizeof(type) * (count))
-#define IsaPushArrayZero(arena, type, count) (type *)IsaArenaPushZero(arena, sizeof(type) * (count))
+/* Typed pushes are aligned for their type. The Aligned variants take a
+ * stricter alignment, e.g. ISA_CACHE_LINE_SIZE to keep arrays that are written
+ * by different threads from sharing lines, or ISA_PAGE_SIZE */
+#define IsaPushArrayAligned(arena, type, count, align)                                                                 \
+    (type *)IsaArenaPushAligned(arena, sizeof(type) * (count), IsaMax((u64)(align), (u64)ISA_ALIGNOF(type)))
+#define IsaPushArrayAlignedZero(arena, type, count, align)                                                             \
+    (type *)IsaArenaPushAlignedZero(arena, sizeof(type) * (count), IsaMax((u64)(align), (u64)ISA_ALIGNOF(type)))
+
+#define IsaPushArray(arena, type, count)     IsaPushArrayAligned(arena, type, count, 1)
+#define IsaPushArrayZero(arena, type, count) IsaPushArrayAlignedZero(arena, type, count, 1)
 
-#define IsaPushStruct(arena, type)     IsaPushArray(arena, type, 1)
-#define IsaPushStructZero(arena, type) IsaPushArrayZero(arena, type, 1)
+#define IsaPushStruct(arena, type)                   IsaPushArray(arena, type, 1)
+#define IsaPushStructZero(arena, type)               IsaPushArrayZero(arena, type, 1)
+#define IsaPushStructAligned(arena, type, align)     IsaPushArrayAligned(arena, type, 1, align)
+#define IsaPushStructAlignedZero(arena, type, align) IsaPushArrayAlignedZero(arena, type, 1, align)
 
 #define IsaNewSlice(arena, len, esize) { len, esize, (u8 *)IsaArenaPushZero(arena, len * esize) }
 
@@ -587,11 +7211,340 @@ IsaArrayShift(void *Mem, u64 From, u64 To, u64 Count, u64 ElementSize)
         Pool->FirstFree = Instance;                                                                                    \
     }
 
-typedef struct isa_string
+/* The atomic pool is a pool that any number of threads can allocate from and
+ * release to at once. Each thread keeps two magazines, small arrays of free
+ * items, for every pool it uses, and most allocs and releases only touch
+ * those. A thread only goes to the shared depot when both its magazines are
+ * empty on alloc or full on release, and then trades a whole magazine at a
+ * time. The depot is two lock-free stacks, one of magazines with items in them
+ * and one of empty ones. Their heads pack a 32-bit generation that counts
+ * every change next to the magazine's index, so a head that was popped and
+ * pushed again between a thread's load and its compare-exchange is caught.
+ * Items and magazines are pushed to an atomic arena, which is where new items
+ * come from when the depot is empty too. Magazines are never handed back to
+ * the arena, so reading one that was just popped by another thread is safe.
+ *
+ * Items in a thread's magazines are only available to that thread until it
+ * calls IsaAtomicPoolThreadFlush, e.g. before it exits. A thread that uses
+ * more pools than ISA_ATOMIC_POOL_THREAD_SLOTS loses the items in the slot it
+ * takes over until the pool is reset. Resetting is only allowed along with
+ * resetting the pool's arena, while both are quiescent */
+
+#if !defined(ISA_ATOMIC_POOL_MAGAZINE_SIZE)
+#define ISA_ATOMIC_POOL_MAGAZINE_SIZE 32 /* Items in a magazine */
+#endif
+
+#if !defined(ISA_ATOMIC_POOL_THREAD_SLOTS)
+#define ISA_ATOMIC_POOL_THREAD_SLOTS 8 /* Atomic pools each thread can keep magazines for at once */
+#endif
+
+typedef struct isa__pool_magazine__
 {
-    u64         Len; /* Does not include the null terminator*/
-    const char *S;   /* Will always be null-terminated for simplicity */
-} isa_string;
+    volatile u32 Next; /* Index of the magazine below this one in a depot stack */
+    u32          Count;
+    void        *Items[ISA_ATOMIC_POOL_MAGAZINE_SIZE];
+} isa__pool_magazine__;
+
+typedef struct isa_atomic_pool
+{
+    volatile u64      Full; /* Depot of magazines with items in them */
+    u8                PadFull__[ISA_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64      Empty; /* Depot of empty magazines */
+    u8                PadEmpty__[ISA_CACHE_LINE_SIZE - sizeof(u64)];
+    isa_atomic_arena *Arena;
+    u64               ItemSize;
+    u64               ItemAlign;
+    volatile u64      Epoch;
+} isa_atomic_pool;
+
+typedef struct isa__atomic_pool_slot__
+{
+    isa_atomic_pool      *Pool;
+    u64                   Epoch;
+    isa__pool_magazine__ *Loaded;
+    isa__pool_magazine__ *Previous;
+} isa__atomic_pool_slot__;
+
+typedef struct isa__atomic_pool_slots__
+{
+    isa__atomic_pool_slot__ Slots[ISA_ATOMIC_POOL_THREAD_SLOTS];
+    u32                     Next;
+} isa__atomic_pool_slots__;
+
+isa__atomic_pool_slots__ *
+Isa__GetAtomicPoolSlots__(void)
+{
+    isa_persist isa_thread_local isa__atomic_pool_slots__ Slots = { 0 };
+    return &Slots;
+}
+
+/**
+ * @param ItemAlign Alignment of the items, a power of two
+ */
+void
+IsaAtomicPoolInit(isa_atomic_pool *Pool, isa_atomic_arena *Arena, u64 ItemSize, u64 ItemAlign)
+{
+    Pool->Full      = 0;
+    Pool->Empty     = 0;
+    Pool->Arena     = Arena;
+    Pool->ItemSize  = ItemSize;
+    Pool->ItemAlign = ItemAlign;
+    Pool->Epoch     = Isa__NextAtomicArenaEpoch__();
+}
+
+/**
+ * @brief Empties the depot and drops every thread's magazines
+ * @note The pool's arena must be reset with it, and both must be quiescent
+ */
+void
+IsaAtomicPoolReset(isa_atomic_pool *Pool)
+{
+    IsaAtomicStore64(&Pool->Full, 0);
+    IsaAtomicStore64(&Pool->Empty, 0);
+    IsaAtomicStore64(&Pool->Epoch, Isa__NextAtomicArenaEpoch__());
+}
+
+// NOTE(ingar): Magazines are pushed cache line aligned, so their index is the
+// number of cache lines they are into the arena, plus one to keep 0 for empty
+uintptr_t
+Isa__PoolMagazineBase__(isa_atomic_pool *Pool)
+{
+    return (uintptr_t)Pool->Arena->Mem & ~(uintptr_t)(ISA_CACHE_LINE_SIZE - 1);
+}
+
+u32
+Isa__PoolMagazineIndex__(isa_atomic_pool *Pool, isa__pool_magazine__ *Magazine)
+{
+    u64 Index = (((uintptr_t)Magazine - Isa__PoolMagazineBase__(Pool)) / ISA_CACHE_LINE_SIZE) + 1;
+    IsaAssert(Index <= UINT32_MAX);
+    return (u32)Index;
+}
+
+isa__pool_magazine__ *
+Isa__PoolMagazine__(isa_atomic_pool *Pool, u32 Index)
+{
+    return (isa__pool_magazine__ *)(Isa__PoolMagazineBase__(Pool) + ((uintptr_t)(Index - 1) * ISA_CACHE_LINE_SIZE));
+}
+
+void
+Isa__PoolDepotPush__(isa_atomic_pool *Pool, volatile u64 *Depot, isa__pool_magazine__ *Magazine)
+{
+    u64 Index = Isa__PoolMagazineIndex__(Pool, Magazine);
+    u64 Head  = IsaAtomicLoad64(Depot);
+    u64 NewHead;
+    do
+    {
+        IsaAtomicStore32(&Magazine->Next, (u32)Head);
+        NewHead = (((Head >> 32) + 1) << 32) | Index;
+    } while(!IsaAtomicCompareExchange64(Depot, &Head, NewHead));
+}
+
+isa__pool_magazine__ *
+Isa__PoolDepotPop__(isa_atomic_pool *Pool, volatile u64 *Depot)
+{
+    u64 Head = IsaAtomicLoad64(Depot);
+    while((u32)Head)
+    {
+        // NOTE(ingar): Another thread may pop the magazine and change Next
+        // before the exchange, but then the generation has moved on as well
+        isa__pool_magazine__ *Magazine = Isa__PoolMagazine__(Pool, (u32)Head);
+        u64                   Next     = IsaAtomicLoadRelaxed32(&Magazine->Next);
+        u64                   NewHead  = (((Head >> 32) + 1) << 32) | Next;
+        if(IsaAtomicCompareExchange64(Depot, &Head, NewHead))
+        {
+            return Magazine;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @return An empty magazine from the depot or the arena, or NULL
+ */
+isa__pool_magazine__ *
+Isa__PoolEmptyMagazine__(isa_atomic_pool *Pool)
+{
+    isa__pool_magazine__ *Magazine = Isa__PoolDepotPop__(Pool, &Pool->Empty);
+    if(!Magazine)
+    {
+        Magazine = (isa__pool_magazine__ *)IsaAtomicArenaPushAligned(Pool->Arena, sizeof(isa__pool_magazine__),
+                                                                     ISA_CACHE_LINE_SIZE);
+        if(Magazine)
+        {
+            Magazine->Next  = 0;
+            Magazine->Count = 0;
+        }
+    }
+
+    return Magazine;
+}
+
+/**
+ * @brief Gives a magazine back to the depot it belongs in
+ */
+void
+Isa__PoolReturnMagazine__(isa_atomic_pool *Pool, isa__pool_magazine__ *Magazine)
+{
+    if(Magazine)
+    {
+        Isa__PoolDepotPush__(Pool, Magazine->Count ? &Pool->Full : &Pool->Empty, Magazine);
+    }
+}
+
+isa__atomic_pool_slot__ *
+Isa__AtomicPoolSlot__(isa_atomic_pool *Pool)
+{
+    isa__atomic_pool_slots__ *Slots = Isa__GetAtomicPoolSlots__();
+    u64                       Epoch = IsaAtomicLoad64(&Pool->Epoch);
+    for(u32 i = 0; i < ISA_ATOMIC_POOL_THREAD_SLOTS; ++i)
+    {
+        isa__atomic_pool_slot__ *Slot = &Slots->Slots[i];
+        if(Slot->Pool == Pool && Slot->Epoch == Epoch)
+        {
+            return Slot;
+        }
+    }
+
+    // NOTE(ingar): The pool that had the slot may be gone, so its magazines
+    // can't be given back
+    isa__atomic_pool_slot__ *Slot = &Slots->Slots[Slots->Next];
+    Slots->Next                   = (Slots->Next + 1) % ISA_ATOMIC_POOL_THREAD_SLOTS;
+    Slot->Pool                    = Pool;
+    Slot->Epoch                   = Epoch;
+    Slot->Loaded                  = NULL;
+    Slot->Previous                = NULL;
+
+    return Slot;
+}
+
+/**
+ * @brief Refills the slot's magazines when both are empty
+ * @return false if the depot had no items
+ */
+ISA_COLD bool
+Isa__AtomicPoolRefill__(isa_atomic_pool *Pool, isa__atomic_pool_slot__ *Slot)
+{
+    isa__pool_magazine__ *Full = Isa__PoolDepotPop__(Pool, &Pool->Full);
+    if(!Full)
+    {
+        return false;
+    }
+
+    // NOTE(ingar): Both magazines are empty, so one of them goes back
+    Isa__PoolReturnMagazine__(Pool, Slot->Previous);
+    Slot->Previous = Slot->Loaded;
+    Slot->Loaded   = Full;
+    return true;
+}
+
+void *
+IsaAtomicPoolAlloc(isa_atomic_pool *Pool)
+{
+    isa__atomic_pool_slot__ *Slot = Isa__AtomicPoolSlot__(Pool);
+    if(!Slot->Loaded || !Slot->Loaded->Count)
+    {
+        if(Slot->Previous && Slot->Previous->Count)
+        {
+            isa__pool_magazine__ *Loaded = Slot->Loaded;
+            Slot->Loaded                 = Slot->Previous;
+            Slot->Previous               = Loaded;
+        }
+        else if(!Isa__AtomicPoolRefill__(Pool, Slot))
+        {
+            return IsaAtomicArenaPushAligned(Pool->Arena, Pool->ItemSize, Pool->ItemAlign);
+        }
+    }
+
+    return Slot->Loaded->Items[--Slot->Loaded->Count];
+}
+
+/**
+ * @brief Makes room in the slot's magazines when both are full
+ * @return false if there was no memory for an empty magazine
+ */
+ISA_COLD bool
+Isa__AtomicPoolMakeRoom__(isa_atomic_pool *Pool, isa__atomic_pool_slot__ *Slot)
+{
+    isa__pool_magazine__ *Empty = Isa__PoolEmptyMagazine__(Pool);
+    if(!Empty)
+    {
+        return false;
+    }
+
+    Isa__PoolReturnMagazine__(Pool, Slot->Previous);
+    Slot->Previous = Slot->Loaded;
+    Slot->Loaded   = Empty;
+    return true;
+}
+
+/**
+ * @note If there is no memory for a magazine to hold it, the item is lost
+ * until the pool is reset
+ */
+void
+IsaAtomicPoolRelease(isa_atomic_pool *Pool, void *Item)
+{
+    isa__atomic_pool_slot__ *Slot = Isa__AtomicPoolSlot__(Pool);
+    if(!Slot->Loaded || (ISA_ATOMIC_POOL_MAGAZINE_SIZE == Slot->Loaded->Count))
+    {
+        if(Slot->Previous && (Slot->Previous->Count < ISA_ATOMIC_POOL_MAGAZINE_SIZE))
+        {
+            isa__pool_magazine__ *Loaded = Slot->Loaded;
+            Slot->Loaded                 = Slot->Previous;
+            Slot->Previous               = Loaded;
+        }
+        else if(!Isa__AtomicPoolMakeRoom__(Pool, Slot))
+        {
+            return;
+        }
+    }
+
+    Slot->Loaded->Items[Slot->Loaded->Count++] = Item;
+}
+
+/**
+ * @brief Gives the calling thread's magazines for the pool to the depot, so
+ * other threads can have their items
+ */
+void
+IsaAtomicPoolThreadFlush(isa_atomic_pool *Pool)
+{
+    isa__atomic_pool_slot__ *Slot = Isa__AtomicPoolSlot__(Pool);
+    Isa__PoolReturnMagazine__(Pool, Slot->Loaded);
+    Isa__PoolReturnMagazine__(Pool, Slot->Previous);
+    Slot->Loaded   = NULL;
+    Slot->Previous = NULL;
+}
+
+/* Like ISA_DEFINE_POOL_ALLOCATOR, but for an atomic pool, so the type needs no
+ * Next member */
+#define ISA_DEFINE_ATOMIC_POOL_ALLOCATOR(type_name, func_name)                                                         \
+    typedef struct type_name##_AtomicPool                                                                              \
+    {                                                                                                                  \
+        isa_atomic_pool Base;                                                                                          \
+    } type_name##_atomic_pool;                                                                                         \
+                                                                                                                       \
+    void func_name##Init(type_name##_atomic_pool *Pool, isa_atomic_arena *Arena)                                       \
+    {                                                                                                                  \
+        IsaAtomicPoolInit(&Pool->Base, Arena, sizeof(type_name), ISA_ALIGNOF(type_name));                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    type_name *func_name##Alloc(type_name##_atomic_pool *Pool)                                                         \
+    {                                                                                                                  \
+        type_name *Result = (type_name *)IsaAtomicPoolAlloc(&Pool->Base);                                              \
+        if(Result)                                                                                                     \
+        {                                                                                                              \
+            IsaMemZeroStruct(Result);                                                                                  \
+        }                                                                                                              \
+                                                                                                                       \
+        return Result;                                                                                                 \
+    }                                                                                                                  \
+                                                                                                                       \
+    void func_name##Release(type_name##_atomic_pool *Pool, type_name *Instance)                                        \
+    {                                                                                                                  \
+        IsaAtomicPoolRelease(&Pool->Base, Instance);                                                                   \
+    }
 
 u64
 IsaStrlen(const char *String)
@@ -984,12 +7937,6 @@ IsaSeedRandPCG(uint32_t Seed)
 //              FILE IO                //
 /////////////////////////////////////////
 
-typedef struct isa_file_data
-{
-    u64     Size;
-    uint8_t Data[];
-} isa_file_data;
-
 /**
  * @note Data is one byte longer than Size to include a null-terminator in case
  * we are working with strings. The null-terminator is always added since we use